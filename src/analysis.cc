@@ -2,8 +2,6 @@
 #include "formatting.h"
 #include "log.h"
 
-#include <unordered_set>
-#include <unordered_map>
 #include <map>
 #include <cassert>
 #include <sstream>
@@ -13,10 +11,10 @@
 
 using namespace std;
 
-template<typename S, typename T>
-map<T,int> count_values(const unordered_map<S,T>& dict) {
+template<typename T>
+map<T,int> count_nonzero_values(const vector<T>& v) {
   map<T,int> ret;
-  for (const auto& kv : dict) ret[kv.second]+=1;
+  for (const T& x : v) if (x) ret[x]+=1;
   return ret;
 }
 
@@ -25,46 +23,110 @@ ostream& operator << (ostream& o, const map<S,T>& dict) {
   for (const auto& kv : dict) o << kv.first << ":" << kv.second << " ";
   return o;
 }
-template<typename T>
-ostream& operator << (ostream& o, const unordered_map<const proof_clause*,T>& dict) {
-  for (const auto& kv : dict) o << kv.first->c << ":" << kv.second << " ";
-  return o;
+
+// Mark, by id, the clauses that the last lemma is derived from. With
+// trails, also the reasons in the trail of each marked lemma, which
+// drawings refer to.
+static vector<bool> used_clauses(const proof& proof, bool trails) {
+  vector<const proof_clause*> lemmas;
+  for (const proof_clause& c : proof.resolution) lemmas.push_back(&c);
+  vector<bool> used(lemmas.empty() ? proof.formula.size() : lemmas.back()->id+1);
+  if (lemmas.empty()) {
+    for (const proof_clause& c : proof.formula) {
+      if (c.c.width() == 0) {
+        used[c.id] = true;
+        break;
+      }
+    }
+    return used;
+  }
+  used[lemmas.back()->id] = true;
+  // Lemmas are only derived from earlier clauses.
+  for (auto it = lemmas.rbegin(); it != lemmas.rend(); ++it) {
+    const proof_clause& c = **it;
+    if (not used[c.id]) continue;
+    for (auto d : c.derivation) used[d->id] = true;
+    if (not trails) continue;
+    for (const branch& b : proof.trails.trail(c.trail)) {
+      if (b.reason) used[b.reason->id] = true;
+    }
+  }
+  return used;
+}
+
+void trim(proof& proof) {
+  size_t axioms = proof.formula.size();
+  size_t before = proof.resolution.size();
+  vector<bool> used = used_clauses(proof, true);
+  // Where each lemma that remains is moved, by its old id.
+  vector<const proof_clause*> moved(used.size());
+  arena<proof_clause> trimmed;
+  for (proof_clause& c : proof.resolution) {
+    if (not used[c.id]) continue;
+    for (auto& d : c.derivation) if (d->id >= axioms) d = moved[d->id];
+    size_t id = c.id;
+    proof_clause& t = trimmed.emplace_back(std::move(c));
+    t.id = axioms + trimmed.size() - 1;
+    moved[id] = &t;
+  }
+  // Trails of removed lemmas are not read again.
+  for (auto& node : proof.trails.nodes) {
+    const proof_clause*& r = node.b.reason;
+    if (r and r->id >= axioms) r = moved[r->id];
+  }
+  proof.resolution = std::move(trimmed);
+  LOG(LOG_ACTIONS) << "Trimmed the proof from " << before << " to "
+                   << proof.resolution.size() << " lemmas" << endl;
+}
+
+cnf unsat_core(const proof& proof) {
+  vector<bool> used = used_clauses(proof, false);
+  cnf core;
+  for (const proof_clause& c : proof.formula) {
+    if (not used[c.id]) continue;
+    core.clauses.push_back(c.c);
+    for (literal l : c.c) core.variables = max(core.variables, int(variable(l))+1);
+  }
+  return core;
 }
 
 void measure(const proof& proof) {
-  unordered_set<const proof_clause*> axioms;
-  for (const proof_clause& c:proof.formula) axioms.insert(&c);
-  unordered_map<const proof_clause*, int> last_used;
-  unordered_map<const proof_clause*, int> out_degree;
+  size_t axioms = proof.formula.size();
+  size_t clauses = axioms + proof.resolution.size();
+  vector<int> last_used(clauses, -1);
+  vector<int> out_degree(clauses);
   vector<uint> input_steps;
   int t=0;
   for (const proof_clause& c:proof.resolution) {
+    assert(c.id == axioms + t);
     input_steps.push_back(c.derivation.size());
     for (auto d:c.derivation) {
-      last_used[d]=t;
-      if (not axioms.count(d)) out_degree[d]+=1;
+      last_used[d->id]=t;
+      if (d->id >= axioms) out_degree[d->id]+=1;
     }
     ++t;
   }
-  for (auto& c:proof.formula) last_used.erase(&c);
   vector<int> remove_n(t);
-  for (auto& kv:last_used) remove_n[kv.second]++;
+  for (size_t i=axioms; i<clauses; ++i) if (last_used[i]>=0) remove_n[last_used[i]]++;
   int space=0;
   int in_use=0;
   t=0;
   for (const proof_clause& c:proof.resolution) {
-    in_use += last_used.count(&c);
+    in_use += (last_used[c.id]>=0);
     space = max(space, in_use);
     in_use -= remove_n[t];
     ++t;
   }
   assert(in_use==0);
   int length = accumulate(input_steps.begin(), input_steps.end(), 0);
-  auto out_degree_sequence = count_values(out_degree);
+  auto out_degree_sequence = count_nonzero_values(out_degree);
+  size_t memory = (last_used.capacity() + out_degree.capacity() + remove_n.capacity())*sizeof(int) +
+    input_steps.capacity()*sizeof(uint);
   LOG(LOG_RESULTS) << "Length " << length << endl;
   LOG(LOG_RESULTS) << "Space " << space << endl;
   LOG(LOG_RESULTS) << "Lemmas " << proof.resolution.size() << endl;
   LOG(LOG_RESULTS) << "Out degree " << out_degree_sequence << endl;
+  LOG(LOG_RESULTS) << "Analysis memory " << memory << " bytes" << endl;
   if (input_steps.size() <1000) {
     LOG(LOG_RESULTS) << "Input steps";
     for (uint x : input_steps) LOG(LOG_RESULTS) << ' ' << x;
@@ -76,7 +138,6 @@ class drawer {
 protected:
   std::ostream& out;
   const struct proof& proof;
-  unordered_set<const proof_clause*> axioms;
   vector<string> lemma_names;
   int conflict;
   string previous_lemma;
@@ -85,24 +146,27 @@ protected:
     lemma_names.clear();
     for (size_t i=0;i<c.derivation.size()-1;++i) {
       stringstream ss;
-      ss << "lemma" << uint64_t(&c);
+      ss << "lemma" << c.id;
       if (i<c.derivation.size()-2) ss << "d" << i;
       lemma_names.push_back(ss.str());
     }    
   }
   string axiom_name(const proof_clause& c, int i) {
     stringstream ss;
-    ss << "axiom" << uint64_t(&c) << "d" << i+1;
+    ss << "axiom" << c.id << "d" << i+1;
     return ss.str();
   }
   string lemma_name(const proof_clause& c) {
     stringstream ss;
-    ss << "lemma" << uint64_t(&c);
+    ss << "lemma" << c.id;
     return ss.str();
   }
+  bool axiom(const proof_clause& c) const {
+    return c.id < proof.formula.size();
+  }
   string box_name(const proof_clause& c) {
     stringstream ss;
-    ss << "dc" << uint64_t(&c);
+    ss << "dc" << c.id;
     return ss.str();
   }
   virtual void begin() {}
@@ -126,7 +190,7 @@ protected:
     clause d = c.derivation.front()->c;
     stack<string> lines;
     for (auto it=c.derivation.begin();it!=c.derivation.end();++it,++i) {
-      if (axioms.count(*it)) {
+      if (axiom(**it)) {
         new_axiom((*it)->c,axiom_name(c,i),lemma_names[max(i,0)],i==-1);
       }
       if (i>=0) {
@@ -143,9 +207,9 @@ protected:
   
   void draw_box(const proof_clause& c) {
     stringstream trail;
-    for (const branch& b : c.trail) {
+    for (const branch& b : proof.trails.trail(c.trail)) {
       new_assignment(trail, b.to, b.reason);
-      if (b.reason and not axioms.count(b.reason)) {
+      if (b.reason and not axiom(*b.reason)) {
         trail_edge(lemma_name(*b.reason), box_name(c));
       }
     }
@@ -158,15 +222,13 @@ protected:
     }
     int i=-1;
     for (auto it=c.derivation.begin();it!=c.derivation.end();++it,++i) {
-      string source = axioms.count(*it)?axiom_name(c, i):lemma_name(**it);
+      string source = axiom(**it)?axiom_name(c, i):lemma_name(**it);
       new_edge(source, lemma_names[max(i,0)]);
     }
   }
 
 public:
-  drawer(std::ostream& from_out, const struct proof& from_proof) : out(from_out), proof(from_proof) {
-    for (const proof_clause& c:proof.formula) axioms.insert(&c);
-  }
+  drawer(std::ostream& from_out, const struct proof& from_proof) : out(from_out), proof(from_proof) {}
   void draw() {
     begin();
     conflict=0;
@@ -381,10 +443,3 @@ public:
 void asy(std::ostream& out, const proof& proof) {
   asy_drawer(out, proof).draw();
 }
-
-void rup(std::ostream& out, const proof& proof) {
-  pretty.mode = pretty.DIMACS;
-  for (const proof_clause& c : proof.resolution) {
-    out << c.c << endl;
-  }
-}
@@ -2,8 +2,14 @@
 
 #include <ostream>
 
+// Drop the lemmas that the last lemma does not depend on, except the
+// reasons in the trails of the lemmas that remain, and number the
+// rest consecutively again.
+void trim(proof& proof);
+// The formula clauses that the last lemma depends on: an
+// unsatisfiable core if the proof is a refutation.
+cnf unsat_core(const proof& proof);
 void measure(const proof& proof);
 void draw(std::ostream& out, const proof& proof);
 void tikz(std::ostream& out, const proof& proof, bool beamer=false);
 void asy(std::ostream& out, const proof& proof);
-void rup(std::ostream& out, const proof& proof);
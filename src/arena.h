@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cassert>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+// Sequence whose elements never move. Elements are allocated in
+// fixed-size chunks, so there is one allocation per chunk instead of
+// one per element, and growing never relocates existing elements.
+// Released elements leave a hole that the next emplace() fills.
+template<typename T, size_t chunk_size = 1024>
+class arena {
+  typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type slot;
+  std::vector<std::unique_ptr<slot[]>> chunks;
+  // Number of slots in use, including holes.
+  size_t n = 0;
+  std::vector<bool> hole;
+  std::vector<size_t> holes;
+
+  T* address(size_t i) const {
+    return reinterpret_cast<T*>(&chunks[i/chunk_size][i%chunk_size]);
+  }
+
+  template<typename S>
+  struct iterator_base :
+  public boost::iterator_facade<
+  iterator_base<S>,S,std::forward_iterator_tag> {
+    const arena* a;
+    size_t i;
+    iterator_base(const arena* from_a, size_t from_i) : a(from_a), i(from_i) { skip(); }
+    S& dereference() const { return *a->address(i); }
+    bool equal(const iterator_base& other) const { return i==other.i; }
+    void increment() { ++i; skip(); }
+    void skip() { while (i<a->n and a->is_hole(i)) ++i; }
+  };
+  bool is_hole(size_t i) const { return i<hole.size() and hole[i]; }
+
+public:
+  typedef T value_type;
+  // Iterators skip holes.
+  typedef iterator_base<T> iterator;
+  typedef iterator_base<const T> const_iterator;
+
+  arena() {}
+  arena(const arena&) = delete;
+  arena& operator = (const arena&) = delete;
+  arena(arena&& other) : chunks(std::move(other.chunks)), n(other.n),
+                         hole(std::move(other.hole)), holes(std::move(other.holes)) {
+    other.chunks.clear();
+    other.n = 0;
+    other.hole.clear();
+    other.holes.clear();
+  }
+  arena& operator = (arena&& other) {
+    reset();
+    chunks = std::move(other.chunks);
+    n = other.n;
+    hole = std::move(other.hole);
+    holes = std::move(other.holes);
+    other.chunks.clear();
+    other.n = 0;
+    other.hole.clear();
+    other.holes.clear();
+    return *this;
+  }
+  ~arena() { release(); }
+
+  template<typename... Args>
+  T& emplace_back(Args&&... args) {
+    if (n == chunks.size()*chunk_size) chunks.emplace_back(new slot[chunk_size]);
+    T* p = new (address(n)) T(std::forward<Args>(args)...);
+    ++n;
+    return *p;
+  }
+  void push_back(T&& x) { emplace_back(std::move(x)); }
+
+  // Construct an element in the most recently released hole, or at
+  // the end if there are none, and return its index.
+  template<typename... Args>
+  size_t emplace(Args&&... args) {
+    if (holes.empty()) {
+      emplace_back(std::forward<Args>(args)...);
+      return n-1;
+    }
+    size_t i = holes.back();
+    new (address(i)) T(std::forward<Args>(args)...);
+    holes.pop_back();
+    hole[i] = false;
+    return i;
+  }
+
+  // Destroy the element at index i.
+  void release(size_t i) {
+    assert(i<n and not is_hole(i));
+    address(i)->~T();
+    if (hole.size() < n) hole.resize(n);
+    hole[i] = true;
+    holes.push_back(i);
+  }
+
+  // Destroy every element, keeping the chunks for the next ones.
+  void reset() {
+    for (size_t i=0; i<n; ++i) if (not is_hole(i)) address(i)->~T();
+    n = 0;
+    hole.clear();
+    holes.clear();
+  }
+  // Destroy every element and free the chunks.
+  void release() {
+    reset();
+    chunks.clear();
+  }
+
+  // Bytes allocated by the arena itself, not by its elements.
+  size_t memory() const {
+    return chunks.capacity()*sizeof(chunks[0]) + chunks.size()*chunk_size*sizeof(slot) +
+      hole.capacity()/8 + holes.capacity()*sizeof(size_t);
+  }
+
+  // Number of elements, not counting holes.
+  size_t size() const { return n - holes.size(); }
+  bool empty() const { return size()==0; }
+  T& operator [] (size_t i) { assert(i<n and not is_hole(i)); return *address(i); }
+  const T& operator [] (size_t i) const { assert(i<n and not is_hole(i)); return *address(i); }
+  T& back() { assert(n and not is_hole(n-1)); return *address(n-1); }
+  const T& back() const { assert(n and not is_hole(n-1)); return *address(n-1); }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, n); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, n); }
+};
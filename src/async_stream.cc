@@ -0,0 +1,100 @@
+#include "async_stream.h"
+
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+async_ostream::async_ostream(const string& path, bool compress) :
+  ostream(nullptr), buf(path, compress) {
+  rdbuf(&buf);
+}
+
+async_ostream::~async_ostream() {
+  rdbuf(nullptr);
+}
+
+async_ostream::buffer::buffer(const string& from_path, bool compress) :
+  path(from_path), chunks(ring_size, vector<char>(chunk_size)), lengths(ring_size),
+  flushes(ring_size) {
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd >= 0 and compress) gz = gzdopen(fd, "wb");
+  if (fd < 0 or (compress and not gz)) {
+    cerr << "Could not open " << path << endl;
+    exit(1);
+  }
+  setp(chunks[0].data(), chunks[0].data()+chunk_size);
+  writer = thread(&buffer::run, this);
+}
+
+async_ostream::buffer::~buffer() {
+  if (pptr() != pbase()) publish();
+  {
+    lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  published.notify_one();
+  writer.join();
+  if (gz) gzclose(gz);
+  else close(fd);
+}
+
+async_ostream::buffer::int_type async_ostream::buffer::overflow(int_type c) {
+  publish();
+  if (not traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = c;
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+// Hand the chunk being filled to the writer, and wait for the next
+// one to be free.
+void async_ostream::buffer::publish(bool flush) {
+  unique_lock<std::mutex> lock(mutex);
+  lengths[tail%ring_size] = pptr()-pbase();
+  flushes[tail%ring_size] = flush;
+  size_t t = ++tail;
+  published.notify_one();
+  written.wait(lock, [this, t] { return t - head < ring_size; });
+  vector<char>& chunk = chunks[t%ring_size];
+  setp(chunk.data(), chunk.data()+chunk_size);
+}
+
+// Write out everything so far, as an unbuffered stream would.
+int async_ostream::buffer::sync() {
+  publish(true);
+  unique_lock<std::mutex> lock(mutex);
+  written.wait(lock, [this] { return head == tail; });
+  return 0;
+}
+
+void async_ostream::buffer::write(const char* data, size_t n) {
+  while (n) {
+    ssize_t count = gz ? gzwrite(gz, data, n) : ::write(fd, data, n);
+    if (count <= 0) {
+      cerr << "Error writing " << path << endl;
+      exit(1);
+    }
+    data += count;
+    n -= count;
+  }
+}
+
+void async_ostream::buffer::run() {
+  unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    published.wait(lock, [this] { return head != tail or done; });
+    if (head == tail) return;
+    size_t h = head%ring_size;
+    // The producer does not touch published chunks.
+    lock.unlock();
+    write(chunks[h].data(), lengths[h]);
+    if (gz and flushes[h]) gzflush(gz, Z_SYNC_FLUSH);
+    lock.lock();
+    ++head;
+    written.notify_one();
+  }
+}
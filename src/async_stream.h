@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+// Output stream whose writes are done by a background thread, so that
+// slow storage does not stall the solver. Bytes are collected in
+// fixed-size chunks that are handed to the writer thread through a
+// ring of chunks with one producer and one consumer. Chunks are
+// written when they are full, when the stream is flushed and when it
+// is destroyed. A flush waits until everything is written, so that
+// nothing is lost if the program exits without destroying the stream.
+class async_ostream : public std::ostream {
+ public:
+  // Writes to path, gzip-compressed if compress is set.
+  async_ostream(const std::string& path, bool compress = false);
+  ~async_ostream();
+ private:
+  class buffer : public std::streambuf {
+   public:
+    buffer(const std::string& from_path, bool compress);
+    ~buffer();
+   protected:
+    virtual int_type overflow(int_type c);
+    virtual int sync();
+   private:
+    static constexpr size_t chunk_size = 1<<18;
+    static constexpr size_t ring_size = 8;
+    std::string path;
+    int fd;
+    gzFile gz = NULL;
+    std::vector<std::vector<char>> chunks;
+    std::vector<size_t> lengths;
+    // Whether the writer flushes the compressor after each chunk. Not
+    // a vector<bool>, whose elements share words between threads.
+    std::vector<char> flushes;
+    // Chunks before head have been written, chunks from head to tail
+    // are waiting for the writer, and chunk tail is being filled.
+    // Both only grow and are reduced modulo ring_size. They are
+    // guarded by the mutex.
+    size_t head = 0, tail = 0;
+    bool done = false;
+    std::mutex mutex;
+    // Signalled when a chunk is published, and when one is written.
+    std::condition_variable published, written;
+    std::thread writer;
+    void publish(bool flush = false);
+    void write(const char* data, size_t n);
+    void run();
+  };
+  buffer buf;
+};
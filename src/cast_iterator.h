@@ -29,6 +29,6 @@ cast_iterator<S>,S,std::random_access_iterator_tag> {
   void decrement() { pointer-=stride; }
   void advance(ptrdiff_t n) { pointer+=(n*stride); }
   ptrdiff_t distance_to(const cast_iterator<S>& other) const {
-    return (other.pointer-pointer)/stride;
+    return (other.pointer-pointer)/ptrdiff_t(stride);
   }
 };
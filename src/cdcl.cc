@@ -5,7 +5,6 @@
 #include <random>
 #include <unordered_map>
 #include <unordered_set>
-
 #include <boost/iterator/function_output_iterator.hpp>
 
 #include "formatting.h"
@@ -15,7 +14,7 @@
 
 using namespace std;
 
-ostream& operator << (ostream& o, const list<proof_clause>& v) {
+ostream& operator << (ostream& o, const arena<proof_clause>& v) {
   for (const auto& i:v) o << "   " << i.c << endl;
   return o;
 };
@@ -45,11 +44,18 @@ bool cdcl::variable_cmp_reverse(variable x, variable y) const {
 }
 
 bool cdcl::consistent() const {
+  size_t reasons_on_trail = 0;
   for (auto branch:branching_seq) {
     int al = assignment[variable(branch.to)];
     assert(al and branch.to.polarity()==(al==1));
+    if (branch.reason) {
+      assert(locked[branch.reason->id]);
+      ++reasons_on_trail;
+    }
   }
-  for (auto branch:propagation_queue.q) {
+  assert(size_t(count(locked.begin(), locked.end(), true)) == reasons_on_trail);
+  for (size_t i=0; i<propagation_queue.size(); ++i) {
+    auto& branch = propagation_queue[i];
     int al = assignment[variable(branch.to)];
     assert((not al) or branch.to.polarity()==(al==1));
   }
@@ -57,22 +63,109 @@ bool cdcl::consistent() const {
     assert(not assignment[v]);
   }
   assert(working_clauses.consistent());
+  for (auto it = working_clauses.begin(); it != working_clauses.end(); ++it) {
+    assert(working_position[it->source->id] == size_t(it - working_clauses.begin()));
+  }
   return true;
 }
 
 bool cdcl::stable() const {
   assert(consistent());
   assert(assignment.size() == branching_seq.size() + decision_order.size());
-  assert(propagation_queue.q.empty());
+  assert(propagation_queue.empty());
   assert(conflicts.empty());
   return true;
 }
 
+// Decide whether the invariants are checked during the next
+// conflict. Without assertions there is nothing to check.
+void cdcl::sample_verification() {
+#ifdef NDEBUG
+  verifying = false;
+#else
+  switch (config_verify) {
+  case VERIFY_OFF:
+    verifying = false;
+    break;
+  case VERIFY_SAMPLED:
+    verifying = generate_canonical<double, 32>(verify_prg) < config_verify_rate;
+    break;
+  case VERIFY_FULL:
+    verifying = true;
+    break;
+  }
+  if (verifying) stats.verified++;
+#endif
+}
+
 void cdcl::display_stats() const {
   LOG(LOG_RESULTS) << "Decisions: " << stats.decisions << endl;
   LOG(LOG_RESULTS) << "Propagations: " << stats.propagations << endl;
   LOG(LOG_RESULTS) << "Conflicts: " << stats.conflicts << endl;
   LOG(LOG_RESULTS) << "Restarts: " << stats.restarts << endl;
+  if (config_otfs) LOG(LOG_RESULTS) << "Strengthened: " << stats.strengthened << endl;
+  LOG(LOG_RESULTS) << "Forgotten: " << stats.forgotten << endl;
+  if (stats.reductions) LOG(LOG_RESULTS) << "Reductions: " << stats.reductions << endl;
+  memory_usage m = memory();
+  LOG(LOG_RESULTS) << "Memory: " << m << endl;
+  LOG(LOG_RESULTS) << "Peak memory: " << (m |= peak) << endl;
+}
+
+memory_usage& memory_usage::operator |= (const memory_usage& other) {
+  formula = max(formula, other.formula);
+  learnt = max(learnt, other.learnt);
+  working = max(working, other.working);
+  watches = max(watches, other.watches);
+  reasons = max(reasons, other.reasons);
+  decision_order = max(decision_order, other.decision_order);
+  metadata = max(metadata, other.metadata);
+  assignment = max(assignment, other.assignment);
+  return *this;
+}
+
+ostream& operator << (ostream& o, const memory_usage& m) {
+  return o << m.total() << " bytes (formula " << m.formula
+           << ", learnt " << m.learnt
+           << ", working " << m.working
+           << ", watches " << m.watches
+           << ", reasons " << m.reasons
+           << ", decision order " << m.decision_order
+           << ", metadata " << m.metadata
+           << ", assignment " << m.assignment << ")";
+}
+
+template<typename T>
+static size_t vector_memory(const vector<T>& v) {
+  return v.capacity()*sizeof(T);
+}
+static size_t vector_memory(const vector<bool>& v) {
+  return v.capacity()/8;
+}
+
+memory_usage cdcl::memory() const {
+  memory_usage m;
+  m.formula = vector_memory(formula);
+  for (const auto& c : formula) m.formula += c.memory();
+  m.learnt = learnt_clauses.memory() + trails.memory() + vector_memory(trail_nodes);
+  for (const auto& c : learnt_clauses) m.learnt += c.memory();
+  for (const auto& s : subsumed_antecedents) m.learnt += s.resolvent.memory();
+  m.learnt += vector_memory(subsumed_antecedents);
+  m.working = working_clauses.memory();
+  m.watches = working_clauses.watch_memory();
+  m.reasons = vector_memory(reasons);
+  for (const auto& r : reasons) {
+    if (r.capacity() > r.static_capacity) m.reasons += r.capacity()*sizeof(const proof_clause*);
+  }
+  // A red-black tree node holds three pointers and a colour besides
+  // the value.
+  m.decision_order = decision_order.size()*(4*sizeof(void*) + sizeof(variable));
+  m.metadata = vector_memory(clause_activity) + vector_memory(clause_lbd) +
+    vector_memory(working_position) + vector_memory(locked) + vector_memory(occurrences);
+  for (const auto& o : occurrences) m.metadata += vector_memory(o);
+  m.assignment = vector_memory(branching_seq) + vector_memory(propagation_queue.q) +
+    vector_memory(assignment) + vector_memory(decision_level) + vector_memory(decision_polarity) +
+    vector_memory(variable_activity) + vector_memory(conflicts);
+  return m;
 }
 
 
@@ -80,15 +173,61 @@ void cdcl::display_stats() const {
  * Main
  */
 
-proof cdcl::solve(const cnf& f) {
+void cdcl::clear() {
+  solved = false;
+  verifying = false;
+  verify_prg.seed();
+  conflicts.clear();
+  formula.clear();
+  learnt_clauses.reset();
+  working_clauses.clear();
+  working_position.clear();
+  occurrences.clear();
+  occurrence_entries = 0;
+  live_occurrences = 0;
+  locked.clear();
+  subsumed_antecedents.clear();
+  branching_seq.clear();
+  trails.nodes.clear();
+  trail_nodes.clear();
+  reasons.clear();
+  propagation_queue.clear();
+  assignment.clear();
+  decision_level.clear();
+  decision_order.clear();
+  decision_polarity.clear();
+  variable_activity.clear();
+  variable_activity_bump = 1;
+  clause_activity.clear();
+  clause_activity_bump = 1;
+  clause_lbd.clear();
+  next_reduce = 0;
+  reduce_interval = 0;
+  last_restart = 0;
+  luby_index = 0;
+  decide_prg.seed();
+  peak = memory_usage();
+  stats = {};
+}
+
+result cdcl::solve(cnf&& f) {
+  clear();
   LOG(LOG_STATE) << f << endl;
   LOG(LOG_ACTIONS) << "Solving a formula with " << f.variables << " variables and " << f.clauses.size() << " clauses" << endl;
 
+  variable_activity = initial_variable_activity(f);
   formula.reserve(f.clauses.size());
-  for (const auto& c : f.clauses) formula.push_back(c);
+  for (auto& c : f.clauses) {
+    formula.push_back(std::move(c));
+    formula.back().id = formula.size()-1;
+  }
+  f.clauses = {};
+  clause_activity.assign(formula.size(), 0);
+  clause_lbd.assign(formula.size(), 0);
+  working_position.assign(formula.size(), not_working);
+  locked.assign(formula.size(), false);
   
   decision_polarity.assign(f.variables, config_default_polarity);
-  variable_activity = initial_variable_activity(f);
   decision_order = set<variable, variable_cmp>
     (bind(variable_order_plugin,
           cref(*this),
@@ -98,13 +237,20 @@ proof cdcl::solve(const cnf& f) {
 
   assignment.resize(f.variables,0);
   reasons.resize(f.variables*2);
+  propagation_queue.reserve(f.variables);
   decision_level.resize(f.variables*2,-1);
   working_clauses.set_variables(f.variables);
-  for (const auto& c : formula) working_clauses.insert(c);
+  occurrences.resize(f.variables);
+  for (const auto& c : formula) {
+    working_clauses.insert(c);
+    index_working(c, working_clauses.size()-1);
+  }
+  if (proof_stream) proof_stream->start(formula);
   restart();
 
   // Main loop
   solved = false;
+  sample_verification();
   while(true) {
     while(not propagation_queue.empty()) {
       unit_propagate();
@@ -116,11 +262,15 @@ proof cdcl::solve(const cnf& f) {
         if (solved) {
           LOG(LOG_RESULTS) << "UNSAT" << endl;
           display_stats();
-          return proof(std::move(formula), std::move(learnt_clauses));
+          result r;
+          r.stats = stats;
+          r.memory = memory();
+          r.proof = proof(std::move(formula), std::move(learnt_clauses), std::move(trails));
+          return r;
         }
       }
     }
-    assert(stable());
+    assert(not verifying or stable());
     forget_plugin(*this);
 #ifndef NO_VIZ
     visualizer_plugin(assignment, working_clauses);
@@ -130,7 +280,12 @@ proof cdcl::solve(const cnf& f) {
       LOG(LOG_EFFECTS) << "This is a satisfying assignment:" << endl << assignment << endl;
       LOG(LOG_RESULTS) << "SAT" << endl;
       display_stats();
-      exit(0);
+      result r;
+      r.sat = true;
+      r.stats = stats;
+      r.memory = memory();
+      r.model = assignment;
+      return r;
     }
   }
   assert(false);
@@ -158,7 +313,7 @@ void cdcl::unit_propagate() {
   if (b.reason) reasons[l.l].push_back(b.reason);
   if (al) {
     // A literal may be propagated more than once for different
-    // reasons. We keep a list of them.
+    // reasons. We keep all of them.
     assert(l.polarity()==(al==1));
     propagation_queue.pop();
     return;
@@ -170,6 +325,7 @@ void cdcl::unit_propagate() {
   decision_level[l.l] = last_decision_level + (b.reason?0:1);
 
   branching_seq.push_back(b);
+  if (b.reason) locked[b.reason->id] = true;
   propagation_queue.pop();
   LOG(LOG_STATE_SUMMARY) << "Branching " << branching_seq << endl;
 
@@ -190,8 +346,10 @@ void cdcl::assign(literal l) {
   if (config_phase_saving) decision_polarity[variable(l)] = l.polarity();
 }
 
-void cdcl::unassign(literal l) {
+void cdcl::unassign(const branch& b) {
+  literal l = b.to;
   LOG(LOG_STATE) << "Backtracking " << l << endl;
+  if (b.reason) locked[b.reason->id] = false;
   auto& al = assignment[variable(l)];
   assert(al);
   al = 0;
@@ -207,6 +365,13 @@ void cdcl::unassign(literal l) {
  * Learning
  */
 
+// Number of decision levels in a falsified clause.
+unsigned cdcl::lbd(const proof_clause& c) const {
+  unordered_set<int> levels;
+  for (literal l : c.c) levels.insert(decision_level[(~l).l]);
+  return levels.size();
+}
+
 bool cdcl::asserting(const proof_clause& c) const {
   eager_restricted_clause d(c);
   d.restrict(assignment);
@@ -273,10 +438,69 @@ proof_clause cdcl::learn_fuip(const branching_sequence::reverse_iterator& first_
     if (asserting(c)) break;
     c.resolve(*it->reason, variable(l));
     LOG(LOG_DETAIL) << "Resolved with " << *reasons[l.l].front() << " and got " << c << endl;
+    if (config_otfs) {
+      if (c.c.subsumes(it->reason->c)) otfs(c, it->reason);
+      else if (c.derivation.size() == 2 and c.c.subsumes(conflict->c)) otfs(c, conflict);
+    }
   }
   return c;
 }
 
+// On-the-fly subsumption. The resolvent c subsumes one of the clauses
+// it was just resolved from, so it can take its place in the working
+// database once we are done with the conflict.
+void cdcl::otfs(const proof_clause& c, const proof_clause* antecedent) {
+  LOG(LOG_DETAIL) << Colour::Modifier(Colour::FG_GREEN) << "Subsumed: " << Colour::Modifier(Colour::FG_DEFAULT) << *antecedent << " by " << c << endl;
+  proof_clause d(c.c);
+  d.derivation = c.derivation;
+  subsumed_antecedents.push_back({antecedent, std::move(d), lbd(c)});
+}
+
+// Replace the antecedents subsumed during conflict analysis. After
+// backtracking, each resolvent has some literal at the conflict
+// level, so it is neither satisfied nor falsified.
+void cdcl::strengthen(const proof_clause& learnt_clause) {
+  // All resolvents are added before any antecedent goes away, since a
+  // resolvent may be derived from an earlier antecedent.
+  vector<proof_clause*> resolvents;
+  for (auto& it : subsumed_antecedents) {
+    if (it.resolvent.c == learnt_clause.c) {
+      resolvents.push_back(NULL);
+      continue;
+    }
+    proof_clause& d = add_lemma(std::move(it.resolvent));
+    clause_lbd[d.id] = it.lbd;
+    if (proof_stream) proof_stream->add(d);
+    resolvents.push_back(&d);
+  }
+  for (size_t i=0; i<subsumed_antecedents.size(); ++i) {
+    const proof_clause* antecedent = subsumed_antecedents[i].antecedent;
+    size_t position = working_position[antecedent->id];
+    assert(position != not_working);
+    auto jt = working_clauses.begin() + position;
+    if (not resolvents[i]) {
+      // The learnt clause itself takes the place of the antecedent.
+      if (position < formula.size()) continue;
+      LOG(LOG_ACTIONS) << "Forgetting " << *antecedent << endl;
+      erase_working(jt);
+      stats.strengthened++;
+      continue;
+    }
+    proof_clause& d = *resolvents[i];
+    d.trail = learnt_clause.trail;
+    LOG(LOG_ACTIONS) << "Strengthening " << *antecedent << " to " << d.c << endl;
+    if(trace) *trace << "# learnt:" << d << endl;
+    unindex_working(*antecedent);
+    working_clauses.replace(jt, d);
+    index_working(d, position);
+    if (proof_stream) proof_stream->remove(*antecedent);
+    release_lemma(*antecedent);
+    if (not config_keep_proof) vector<const proof_clause*>().swap(d.derivation);
+    stats.strengthened++;
+  }
+  subsumed_antecedents.clear();
+}
+
 // Find the learnt clause by resolving with all the reasons in the
 // last decision level. Only the decision variable remains so the
 // result must be asserting.
@@ -340,6 +564,16 @@ void cdcl::minimize(proof_clause& c) const {
   }
 }
 
+// Store the part of the branching sequence that is not shared with
+// the previous trail.
+size_t cdcl::record_trail() {
+  for (size_t i = trail_nodes.size(); i < branching_seq.size(); ++i) {
+    size_t parent = i ? trail_nodes[i-1] : trail_store::root;
+    trail_nodes.push_back(trails.push(branching_seq[i], parent));
+  }
+  return trail_nodes.empty() ? trail_store::root : trail_nodes.back();
+}
+
 void cdcl::backjump(const proof_clause& learnt_clause,
                     const branching_sequence::reverse_iterator& first_decision,
                     branching_sequence::reverse_iterator& backtrack_limit) {
@@ -364,7 +598,7 @@ void cdcl::backjump(const proof_clause& learnt_clause,
   
   // Actually backtrack
   for (auto it=first_decision+1; it!=backtrack_limit; ++it) {
-    unassign(it->to);
+    unassign(*it);
   }
 }
 
@@ -375,7 +609,7 @@ void cdcl::learn() {
   // Backtrack to first decision level.
   auto first_decision = branching_seq.rbegin();
   for (;first_decision != branching_seq.rend(); ++first_decision) {
-    unassign(first_decision->to);
+    unassign(*first_decision);
     if (not first_decision->reason) break;
   }
 
@@ -383,24 +617,31 @@ void cdcl::learn() {
   if (first_decision == branching_seq.rend()) solved = true;
 
   assert(first_decision != branching_seq.rbegin());
-  learnt_clauses.emplace_back(learn_plugin(*this, first_decision));
-  proof_clause& learnt_clause = learnt_clauses.back();
+  subsumed_antecedents.clear();
+  proof_clause& learnt_clause = add_lemma(learn_plugin(*this, first_decision));
 
   if (config_minimize) minimize(learnt_clause);
+  clause_lbd[learnt_clause.id] = lbd(learnt_clause);
+  if (proof_stream) proof_stream->add(learnt_clause);
 
   LOG(LOG_EFFECTS) << Colour::Modifier(Colour::FG_GREEN) << "Learned: " << Colour::Modifier(Colour::FG_DEFAULT) << learnt_clause << endl;
   if(trace) *trace << "# learnt:" << learnt_clause << endl;
-  clause d = learnt_clause.derivation.front()->c;
-  for (auto it=++learnt_clause.derivation.begin();it!=learnt_clause.derivation.end();++it) {
-    d = resolve(d,(*it)->c);
+  if (config_record_trails) learnt_clause.trail = record_trail();
+
+  sample_verification();
+  if (verifying) {
+    // Replay the derivation.
+    clause d = learnt_clause.derivation.front()->c;
+    for (auto it=++learnt_clause.derivation.begin();it!=learnt_clause.derivation.end();++it) {
+      d = resolve(d,(*it)->c);
+    }
+    assert(d == learnt_clause.c);
+    assert(not config_backjump or
+           find_if(working_clauses.begin(), working_clauses.end(),
+                   [&learnt_clause] (const auto& i) {
+                     return i.source->c == learnt_clause.c;
+                   }) == working_clauses.end());
   }
-  learnt_clause.trail = branching_seq;
-
-  assert(not config_backjump or
-         find_if(working_clauses.begin(), working_clauses.end(),
-                 [&learnt_clause] (const auto& i) {
-                   return i.source->c == learnt_clause.c;
-                 }) == working_clauses.end());
   
   if (solved) {
     LOG(LOG_EFFECTS) << "I learned the following clauses:" << endl << learnt_clauses << endl;
@@ -416,13 +657,18 @@ void cdcl::learn() {
     decision_level[it->to.l]=-1;
   }
   branching_seq.erase(backtrack_limit.base(),branching_seq.end());
+  if (trail_nodes.size() > branching_seq.size()) trail_nodes.resize(branching_seq.size());
 
   bump_activity(learnt_clause);
   bump_clause_activity(learnt_clause);
 
+  strengthen(learnt_clause);
+  if (not config_keep_proof) vector<const proof_clause*>().swap(learnt_clause.derivation);
+
   // Add the learnt clause to working clauses and immediately start
   // propagating
-  working_clauses.insert(learnt_clauses.back(), assignment);
+  working_clauses.insert(learnt_clause, assignment);
+  index_working(learnt_clause, working_clauses.size()-1);
 
   LOG(LOG_STATE) << "Branching " << branching_seq << endl;
   // There may be a more efficient way to do this.
@@ -431,6 +677,7 @@ void cdcl::learn() {
 
   conflicts.clear();
   stats.conflicts++;
+  if (stats.conflicts % memory_interval == 0) sample_memory();
 }
 
 
@@ -503,15 +750,109 @@ vector<double> cdcl::initial_variable_activity(const cnf& f) {
   return variable_activity_none(f);
 }
 
+proof_clause& cdcl::add_lemma(proof_clause&& c) {
+  size_t slot = learnt_clauses.emplace(std::move(c));
+  proof_clause& d = learnt_clauses[slot];
+  d.id = formula.size() + slot;
+  if (d.id == clause_activity.size()) {
+    clause_activity.push_back(0);
+    clause_lbd.push_back(0);
+    working_position.push_back(not_working);
+    locked.push_back(false);
+  }
+  else {
+    clause_activity[d.id] = 0;
+    clause_lbd[d.id] = 0;
+    assert(working_position[d.id] == not_working);
+    assert(not locked[d.id]);
+  }
+  return d;
+}
+
+// Free a learnt clause that has left the working set, unless it is
+// part of the proof.
+void cdcl::release_lemma(const proof_clause& c) {
+  if (config_keep_proof or c.id < formula.size()) return;
+  assert(working_position[c.id] == not_working);
+  assert(not locked[c.id]);
+  // It may still be an additional reason of an assigned literal.
+  for (literal l : c.c) {
+    auto& r = reasons[l.l];
+    r.erase(remove(r.begin(), r.end(), &c), r.end());
+  }
+  learnt_clauses.release(c.id - formula.size());
+}
+
+// Lemmas that take the place of a formula clause are not indexed, so
+// that they are never forgotten.
+static bool indexed(size_t id, size_t position, size_t formula_size) {
+  return id >= formula_size and position >= formula_size;
+}
+
+void cdcl::index_working(const proof_clause& c, size_t position) {
+  working_position[c.id] = position;
+  if (not indexed(c.id, position, formula.size())) return;
+  for (auto it = c.c.dom_begin(); it != c.c.dom_end(); ++it) {
+    occurrences[*it].push_back(c.id);
+  }
+  occurrence_entries += c.c.width();
+  live_occurrences += c.c.width();
+  if (occurrence_entries > 2*live_occurrences + occurrences.size()) compact_occurrences();
+}
+
+void cdcl::unindex_working(const proof_clause& c) {
+  size_t position = working_position[c.id];
+  assert(position != not_working);
+  working_position[c.id] = not_working;
+  if (indexed(c.id, position, formula.size())) live_occurrences -= c.c.width();
+}
+
+// Keep only the entries of indexed working clauses that contain the
+// variable. Ids of released lemmas may have been reused by clauses
+// that do not.
+void cdcl::compact_occurrences() {
+  occurrence_entries = 0;
+  for (variable x = 0; x < occurrences.size(); ++x) {
+    auto& occurrence = occurrences[x];
+    sort(occurrence.begin(), occurrence.end());
+    occurrence.erase(unique(occurrence.begin(), occurrence.end()), occurrence.end());
+    occurrence.erase(remove_if(occurrence.begin(), occurrence.end(),
+                               [this, x] (size_t id) {
+                                 size_t position = working_position[id];
+                                 if (position == not_working or
+                                     not indexed(id, position, formula.size())) return true;
+                                 const clause& c = learnt_clauses[id - formula.size()].c;
+                                 return not binary_search(c.dom_begin(), c.dom_end(), x);
+                               }),
+                     occurrence.end());
+    occurrence.shrink_to_fit();
+    occurrence_entries += occurrence.size();
+  }
+  assert(occurrence_entries == live_occurrences);
+}
+
+clause_database_i::clause_iterator cdcl::erase_working(clause_database_i::clause_iterator it) {
+  const proof_clause* c = it->source;
+  unindex_working(*c);
+  it = working_clauses.erase(it);
+  // The last clause has been moved into the gap.
+  if (it != working_clauses.end()) {
+    working_position[it->source->id] = it - working_clauses.begin();
+  }
+  if (proof_stream) proof_stream->remove(*c);
+  release_lemma(*c);
+  return it;
+}
+
 void cdcl::bump_clause_activity(const proof_clause& c) {
   clause_activity_bump/=config_clause_decay;
   bool rescale = false;
   for (const proof_clause* d : c.derivation) {
-    clause_activity[d]+=clause_activity_bump;
-    rescale |= (clause_activity[d] >= ACTIVITY_LIMIT);
+    clause_activity[d->id]+=clause_activity_bump;
+    rescale |= (clause_activity[d->id] >= ACTIVITY_LIMIT);
   }
   if (rescale) {
-    for (auto& it : clause_activity) it.second/=ACTIVITY_LIMIT;
+    for (double& a : clause_activity) a/=ACTIVITY_LIMIT;
     clause_activity_bump/=ACTIVITY_LIMIT;
   }
 }
@@ -536,9 +877,8 @@ void cdcl::decide() {
 }
 
 literal cdcl::decide_random() {
-  static minstd_rand prg;
   auto it = decision_order.begin();
-  advance(it, prg()%decision_order.size());
+  advance(it, decide_prg()%decision_order.size());
   int decision_variable = *it;
   decision_order.erase(it);
   return literal(decision_variable,decision_polarity[decision_variable]);
@@ -555,10 +895,9 @@ bool cdcl::restart_none() {
 }
 
 bool cdcl::restart_always() {
-  static uint next_restart = 1;
-  uint num_conflicts = learnt_clauses.size();
-  if (num_conflicts >= next_restart) {
-    next_restart = num_conflicts + 1;
+  uint num_conflicts = stats.conflicts;
+  if (num_conflicts > last_restart) {
+    last_restart = num_conflicts;
     return true;
   }
   return false;
@@ -572,11 +911,12 @@ uint luby(uint i) {
 
 bool cdcl::restart_luby() {
   const uint luby_factor = 100;
-  static uint next_restart = luby_factor;
-  static uint luby_i = 0;
-  uint num_conflicts = learnt_clauses.size();
-  if (num_conflicts >= next_restart) {
-    next_restart = num_conflicts + luby_factor*luby(++luby_i);
+  // The first interval is luby_factor, then the Luby sequence follows.
+  uint interval = luby_index ? luby_factor*luby(luby_index) : luby_factor;
+  uint num_conflicts = stats.conflicts;
+  if (num_conflicts >= last_restart + interval) {
+    last_restart = num_conflicts;
+    ++luby_index;
     return true;
   }
   return false;
@@ -584,15 +924,21 @@ bool cdcl::restart_luby() {
 
 void cdcl::restart() {
   LOG(LOG_ACTIONS) << "Restarting" << endl;
-  for (auto branch:branching_seq) decision_order.insert(variable(branch.to));
-  fill(assignment.begin(), assignment.end(), 0);
-  fill(reasons.begin(), reasons.end(), list<const proof_clause*>());
-  fill(decision_level.begin(), decision_level.end(), -1);
+  // Only literals in the branching sequence have been touched.
+  for (auto branch:branching_seq) {
+    decision_order.insert(variable(branch.to));
+    assignment[variable(branch.to)] = 0;
+    reasons[branch.to.l].clear();
+    decision_level[branch.to.l] = -1;
+    if (branch.reason) locked[branch.reason->id] = false;
+  }
   branching_seq.clear();
+  trail_nodes.clear();
   propagation_queue.clear();
 
   working_clauses.reset();
   stats.restarts++;
+  sample_memory();
 }
 
 
@@ -604,64 +950,149 @@ void cdcl::restart() {
 void cdcl::forget_nothing() {}
 
 // Forget clauses wider than w
-void cdcl::forget_wide(unsigned int w) {
-  forget_if([w](const clause& c) { return c.width() > w; });
+size_t cdcl::forget_wide(unsigned int w) {
+  return forget_if([w](const proof_clause& c) { return c.c.width() > w; });
 }
 
 void cdcl::forget_wide() {
   if (working_clauses.back().source->c.width() <= 2) forget_wide(2);
 }
 
-void cdcl::forget_if(const function<bool(clause)>& predicate) {
+size_t cdcl::forget_if(const function<bool(const proof_clause&)>& predicate) {
   assert(propagation_queue.empty());
-  unordered_set<const proof_clause*> busy;
-  for (auto branch : branching_seq) busy.insert(branch.reason);
+  size_t forgotten = 0;
   for (auto it = working_clauses.begin() + formula.size(); it!=working_clauses.end(); ) {
-    if (predicate(it->source->c)
-        and busy.count(it->source) == 0) {
+    if (not locked[it->source->id]
+        and predicate(*it->source)) {
       LOG(LOG_ACTIONS) << "Forgetting " << *it->source << endl;
-      it = working_clauses.erase(it);
+      it = erase_working(it);
+      ++forgotten;
     }
     else {
       ++it;
     }
   }
-  
+  stats.forgotten += forgotten;
+  return forgotten;
+}
+
+// As forget_if, but only looking at learnt clauses that contain some
+// variable in the domain.
+size_t cdcl::forget_occurring(const vector<variable>& domain,
+                              const function<bool(const proof_clause&)>& predicate) {
+  assert(propagation_queue.empty());
+  vector<size_t> candidates;
+  for (variable x : domain) {
+    if (x >= occurrences.size()) continue;
+    auto& occurrence = occurrences[x];
+    // Drop clauses that are no longer working, and reused ids of
+    // lemmas that took the place of a formula clause.
+    size_t size = occurrence.size();
+    occurrence.erase(remove_if(occurrence.begin(), occurrence.end(),
+                               [this] (size_t id) {
+                                 return working_position[id] == not_working or
+                                   working_position[id] < formula.size();
+                               }),
+                     occurrence.end());
+    occurrence_entries -= size - occurrence.size();
+    candidates.insert(candidates.end(), occurrence.begin(), occurrence.end());
+  }
+  sort(candidates.begin(), candidates.end());
+  candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+  size_t forgotten = 0;
+  for (size_t id : candidates) {
+    const proof_clause& c = learnt_clauses[id - formula.size()];
+    if (locked[id] or not predicate(c)) continue;
+    LOG(LOG_ACTIONS) << "Forgetting " << c << endl;
+    erase_working(working_clauses.begin() + working_position[id]);
+    ++forgotten;
+  }
+  stats.forgotten += forgotten;
+  return forgotten;
 }
 
-void cdcl::forget_domain(const vector<variable>& domain) {
+size_t cdcl::forget_domain(const vector<variable>& domain) {
   vector<variable> dom(domain);
   sort(dom.begin(), dom.end());
-  forget_if([&dom](const clause& c) {
+  uint64_t signature = clause::domain_signature(dom);
+  return forget_occurring(dom, [&dom, signature](const proof_clause& c) {
+      if (c.c.domain_signature() & ~signature) return false;
       return includes(dom.begin(), dom.end(),
-                      c.dom_begin(), c.dom_end());
+                      c.c.dom_begin(), c.c.dom_end());
     });
 }
 
-void cdcl::forget_touches_all(const vector<variable>& domain) {
+size_t cdcl::forget_touches_all(const vector<variable>& domain) {
   vector<variable> dom(domain);
   sort(dom.begin(), dom.end());
-  forget_if([&dom](const clause& c) {
-      return includes(c.dom_begin(), c.dom_end(),
+  if (dom.empty()) return forget_if([](const proof_clause& c) { return true; });
+  uint64_t signature = clause::domain_signature(dom);
+  // Every candidate contains the rarest variable of the domain.
+  variable rarest = *min_element(dom.begin(), dom.end(),
+                                 [this] (variable x, variable y) {
+                                   if (y >= occurrences.size()) return x < occurrences.size();
+                                   if (x >= occurrences.size()) return false;
+                                   return occurrences[x].size() < occurrences[y].size();
+                                 });
+  return forget_occurring({rarest}, [&dom, signature](const proof_clause& c) {
+      if (signature & ~c.c.domain_signature()) return false;
+      return includes(c.c.dom_begin(), c.c.dom_end(),
                       dom.begin(), dom.end());
     });
 }
 
-void cdcl::forget_touches_any(const vector<variable>& domain) {
+size_t cdcl::forget_touches_any(const vector<variable>& domain) {
   vector<variable> dom(domain);
   sort(dom.begin(), dom.end());
-  forget_if([&dom](const clause& c) {
+  uint64_t signature = clause::domain_signature(dom);
+  // Candidates whose id has been reused may not touch the domain.
+  return forget_occurring(dom, [&dom, signature](const proof_clause& c) {
+      if (not (signature & c.c.domain_signature())) return false;
       bool empty = true;
       auto set_is_empty = [&empty] (variable) { empty=false; };
-      set_intersection(c.dom_begin(), c.dom_end(),
+      set_intersection(c.c.dom_begin(), c.c.dom_end(),
                        dom.begin(), dom.end(),
                        boost::make_function_output_iterator(set_is_empty));
       return not empty;
     });
-    }
+}
+
+// Periodically forget the half of the learnt clauses with the highest
+// literal block distance, breaking ties by activity. Glue clauses are
+// always kept.
+void cdcl::forget_reduce() {
+  const double reduce_factor = 1.1;
+  const unsigned glue = 2;
+  if (not reduce_interval) {
+    reduce_interval = max(1u, config_reduce_first);
+    next_reduce = reduce_interval;
+  }
+  if (stats.conflicts < next_reduce) return;
+  // Grow by at least one conflict, so that short intervals grow too.
+  reduce_interval = max(reduce_interval * reduce_factor, reduce_interval + 1);
+  next_reduce = stats.conflicts + reduce_interval;
+  stats.reductions++;
+
+  vector<const proof_clause*> candidates;
+  for (auto it = working_clauses.begin() + formula.size(); it!=working_clauses.end(); ++it) {
+    if (clause_lbd[it->source->id] > glue) candidates.push_back(it->source);
+  }
+  sort(candidates.begin(), candidates.end(),
+       [this] (const proof_clause* a, const proof_clause* b) {
+         unsigned la = clause_lbd[a->id], lb = clause_lbd[b->id];
+         if (la != lb) return la > lb;
+         return clause_activity[a->id] < clause_activity[b->id];
+       });
+  candidates.resize(candidates.size()/2);
+  LOG(LOG_ACTIONS) << "Reducing " << candidates.size() << " learnt clauses" << endl;
+  vector<bool> reduce(clause_activity.size());
+  for (const proof_clause* c : candidates) reduce[c->id] = true;
+  forget_if([&reduce](const proof_clause& c) { return reduce[c.id]; });
+}
 
 void cdcl::forget_everything() {
-  forget_if([](const clause& c) { return true; });
+  forget_if([](const proof_clause& c) { return true; });
 }
 
 void cdcl::forget(unsigned int m) {
@@ -671,11 +1102,10 @@ void cdcl::forget(unsigned int m) {
   auto it = working_clauses.begin()+m;
   const auto& target = *it;
   LOG(LOG_ACTIONS) << "Forgetting " << *target.source << endl;
-  for (const auto& branch : branching_seq) {
-    if (branch.reason == target.source) {
-      LOG(LOG_ACTIONS) << *target.source << " is used to propagate " << branch.to << "; refusing to forget it." << endl;
-      return;
-    }
+  if (locked[target.source->id]) {
+    LOG(LOG_ACTIONS) << *target.source << " is used to propagate; refusing to forget it." << endl;
+    return;
   }
-  working_clauses.erase(it);
+  erase_working(it);
+  stats.forgotten++;
 }
@@ -8,11 +8,17 @@
 #include <iostream>
 #include <memory>
 #include <unordered_set>
+#include <random>
+
+#include <boost/container/small_vector.hpp>
 
 #include "reference_clause_database.h"
 #include "watched_clause_database.h"
 #include "data_structures.h"
 #include "propagation_queue.h"
+#include "proof_writer.h"
+
+std::ostream& operator << (std::ostream& o, const memory_usage& m);
 
 class cdcl {
  public:
@@ -23,7 +29,11 @@ class cdcl {
   cdcl& operator = (const cdcl&) = delete;
   ~cdcl() { delete &working_clauses; }
 
-  proof solve(const cnf& f);
+  // Takes over the clauses of f. The solver may be reused afterwards.
+  result solve(cnf&& f);
+  // Forget the formula and the search state, keeping allocated
+  // buffers.
+  void clear();
 
   std::function<literal(cdcl&)> decide_plugin;
   std::function<bool(cdcl&)> restart_plugin;
@@ -37,10 +47,29 @@ std::function<proof_clause(cdcl&, const branching_sequence::reverse_iterator&)>
 
   bool config_backjump;
   bool config_minimize;
+  bool config_otfs;
+  // Keep the branching sequence of every conflict for the proof.
+  bool config_record_trails;
+  // Keep every lemma and its derivation for the proof. Otherwise
+  // derivations are dropped after learning and forgotten lemmas are
+  // released.
+  bool config_keep_proof;
   bool config_phase_saving;
   bool config_default_polarity;
   double config_activity_decay;
   double config_clause_decay;
+  // Conflicts before the first reduction of the learnt clauses, at
+  // least one.
+  unsigned config_reduce_first;
+  // How often the invariant checks and the derivation replay run in
+  // checked builds.
+  enum verify_level {
+    VERIFY_OFF,
+    VERIFY_SAMPLED,
+    VERIFY_FULL,
+  } config_verify;
+  // Fraction of conflicts that are checked in sampled mode.
+  double config_verify_rate;
 
   literal decide_fixed();
   literal decide_random();
@@ -64,13 +93,21 @@ std::function<proof_clause(cdcl&, const branching_sequence::reverse_iterator&)>
   void forget_nothing();
   void forget_everything();
   void forget_wide();
-  void forget_wide(unsigned int w);
-  void forget_domain(const std::vector<variable>& domain);
-  void forget_touches_all(const std::vector<variable>& domain);
-  void forget_touches_any(const std::vector<variable>& domain);
-  void forget_if(const std::function<bool(clause)>& predicate);
+  // The following return the number of clauses forgotten.
+  size_t forget_wide(unsigned int w);
+  size_t forget_domain(const std::vector<variable>& domain);
+  size_t forget_touches_all(const std::vector<variable>& domain);
+  size_t forget_touches_any(const std::vector<variable>& domain);
+  void forget_reduce();
+  size_t forget_if(const std::function<bool(const proof_clause&)>& predicate);
 
   std::shared_ptr<std::ostream> trace;
+  // Told about every lemma and every deletion as they happen.
+  std::shared_ptr<proof_writer> proof_stream;
+
+  memory_usage memory() const;
+  // Largest value of each part of memory() so far.
+  const memory_usage& peak_memory() const { return peak; }
   
 private:
   friend class ui;
@@ -78,42 +115,85 @@ private:
   void unit_propagate();
   void learn();
   void forget(unsigned int m);
+  size_t forget_occurring(const std::vector<variable>& domain,
+                          const std::function<bool(const proof_clause&)>& predicate);
   void decide();
   void restart();
   
   void assign(literal l);
-  void unassign(literal l);
+  void unassign(const branch& b);
   bool asserting(const proof_clause& c) const;
+  unsigned lbd(const proof_clause& c) const;
   void backjump(const proof_clause& learnt_clause,
                 const branching_sequence::reverse_iterator& first_decision,
                 branching_sequence::reverse_iterator& backtrack_limit);
   void minimize(proof_clause& c) const;
+  size_t record_trail();
+  void otfs(const proof_clause& c, const proof_clause* antecedent);
+  void strengthen(const proof_clause& learnt_clause);
   void bump_activity(const proof_clause& c);
+  proof_clause& add_lemma(proof_clause&& c);
+  void index_working(const proof_clause& c, size_t position);
+  void unindex_working(const proof_clause& c);
+  void compact_occurrences();
+  void release_lemma(const proof_clause& c);
+  clause_database_i::clause_iterator erase_working(clause_database_i::clause_iterator it);
   void bump_clause_activity(const proof_clause& c);
   std::vector<double> initial_variable_activity(const cnf& f);
 
   bool consistent() const;
   bool stable() const;
+  void sample_verification();
   void display_stats() const;
   
   bool solved; // Done
+  // Whether invariants are checked until the next conflict.
+  bool verifying;
+  std::minstd_rand verify_prg;
   std::vector<const proof_clause*> conflicts;
   
   // Copy of the formula.
   std::vector<proof_clause> formula;
   // Learnt clauses, in order. We will pointers to proof clauses, so
-  // they should not be erased or reallocated.
-  std::list<proof_clause> learnt_clauses;
+  // they should not be erased or reallocated. Without a proof, the
+  // slots of released lemmas are reused, and so are their ids.
+  arena<proof_clause> learnt_clauses;
   // Clauses restricted to the current assignment.
   clause_database_i& working_clauses;
+  // Position of each clause in working_clauses, indexed by clause id.
+  static constexpr size_t not_working = -1;
+  std::vector<size_t> working_position;
+  // Ids of the learnt clauses containing each variable, except those
+  // that took the place of a formula clause. Ids of clauses that are no
+  // longer working are dropped lazily, and the lists are compacted
+  // when most of their entries are stale.
+  std::vector<std::vector<size_t>> occurrences;
+  size_t occurrence_entries = 0;
+  // Entries that belong to indexed working clauses.
+  size_t live_occurrences = 0;
+  // Whether each clause is the reason of a literal in the branching
+  // sequence, indexed by clause id. Locked clauses are not forgotten.
+  std::vector<bool> locked;
+  // Intermediate resolvents found during conflict analysis, together
+  // with the antecedent they subsume.
+  struct subsumed_antecedent {
+    const proof_clause* antecedent;
+    proof_clause resolvent;
+    unsigned lbd;
+  };
+  std::vector<subsumed_antecedent> subsumed_antecedents;
 
   // List of unit propagations, in chronological order.
   branching_sequence branching_seq;
+  // Trails of the conflicts so far, and the node of each recorded
+  // prefix of the branching sequence.
+  trail_store trails;
+  std::vector<size_t> trail_nodes;
   // Reasons for propagation, indexed by literal number. If a
   // propagated literal does not have any reason, then it was
   // decided. It is possible for a literal to have multiple reasons
   // before being propagated; we choose the first as the main reason.
-  std::vector<std::list<const proof_clause*>> reasons;
+  std::vector<boost::container::small_vector<const proof_clause*,1>> reasons;
   // Queue of literals waiting to be unit-propagated.
   struct propagation_queue propagation_queue;
   // Assignment induced by the branching sequence, indexed by variable
@@ -133,17 +213,31 @@ private:
   // Exponential moving average of each variable appearing in a conflict.
   std::vector<double> variable_activity;
   double variable_activity_bump = 1;
-  // Exponential moving average of each clause appearing in a conflict.
-  std::unordered_map<const proof_clause*, double> clause_activity;
+  // Exponential moving average of each clause appearing in a
+  // conflict, indexed by clause id.
+  std::vector<double> clause_activity;
   double clause_activity_bump = 1;
-
-  struct stats {
-    int decisions, propagations, conflicts, restarts;
-    stats() : decisions(0), propagations(0), conflicts(0), restarts(0) {}
-  } stats;
+  // Literal block distance of each learnt clause when it was learnt,
+  // indexed by clause id.
+  std::vector<unsigned> clause_lbd;
+  // Conflicts until the next database reduction, and the gap until
+  // the one after.
+  int next_reduce = 0;
+  double reduce_interval = 0;
+  // Conflicts at the last restart, and position in the Luby sequence.
+  unsigned last_restart = 0;
+  unsigned luby_index = 0;
+  std::minstd_rand decide_prg;
+
+  // Sampled on restarts and every memory_interval conflicts.
+  static constexpr int memory_interval = 1024;
+  memory_usage peak;
+  void sample_memory() { peak |= memory(); }
+
+  solver_stats stats;
 };
 
-std::ostream& operator << (std::ostream& o, const std::list<proof_clause>& v);
+std::ostream& operator << (std::ostream& o, const arena<proof_clause>& v);
 std::ostream& operator << (std::ostream& o, const branch& b);
 
 template<typename T>
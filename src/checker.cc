@@ -0,0 +1,594 @@
+#include "checker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#include <boost/functional/hash.hpp>
+
+#include "arena.h"
+#include "formatting.h"
+#include "log.h"
+#include "propagation_queue.h"
+#include "watched_clause_database.h"
+
+using namespace std;
+
+namespace {
+
+constexpr size_t npos = -1;
+
+unsigned thread_count(unsigned threads) {
+  if (threads) return threads;
+  return max(1u, thread::hardware_concurrency());
+}
+
+void malformed() {
+  cerr << "Malformed proof" << endl;
+  exit(1);
+}
+
+// Skip blanks and comment lines. False at the end of the input.
+bool skip_blanks(istream& in) {
+  for (;;) {
+    int c = in.peek();
+    if (c == EOF) return false;
+    if (c == 'c') in.ignore(numeric_limits<streamsize>::max(), '\n');
+    else if (isspace(c)) in.get();
+    else return true;
+  }
+}
+
+long read_number(istream& in) {
+  long x;
+  if (not (in >> x)) malformed();
+  return x;
+}
+
+clause normalize(vector<literal>& literals) {
+  sort(literals.begin(), literals.end());
+  literals.erase(unique(literals.begin(), literals.end()), literals.end());
+  return clause(literals);
+}
+
+// Lines of a DRAT proof: lemmas and deletions.
+class drat_reader {
+public:
+  drat_reader(istream& from_in, bool from_binary) : in(from_in), binary(from_binary) {}
+  // False at the end of the proof.
+  bool next(bool& deletion, vector<literal>& literals) {
+    literals.clear();
+    return binary ? next_binary(deletion, literals) : next_text(deletion, literals);
+  }
+private:
+  istream& in;
+  bool binary;
+  bool next_text(bool& deletion, vector<literal>& literals) {
+    if (not skip_blanks(in)) return false;
+    deletion = in.peek() == 'd';
+    if (deletion) in.get();
+    for (long x; (x = read_number(in));) literals.push_back(literal::from_dimacs(x));
+    return true;
+  }
+  // Literals are variable-length integers, 2*(variable+1) plus one if
+  // negative, as binary_drat_writer writes them.
+  bool next_binary(bool& deletion, vector<literal>& literals) {
+    int kind = in.get();
+    if (kind == EOF) return false;
+    if (kind != 'a' and kind != 'd') malformed();
+    deletion = kind == 'd';
+    for (;;) {
+      uint64_t x = 0;
+      int byte;
+      for (int shift=0; ; shift+=7) {
+        byte = in.get();
+        if (byte == EOF or shift > 63) malformed();
+        x |= uint64_t(byte & 0x7f) << shift;
+        if (not (byte & 0x80)) break;
+      }
+      if (not x) return true;
+      if (x < 2) malformed();
+      literals.push_back(literal(x/2-1, not (x&1)));
+    }
+  }
+};
+
+// A unit clause, as the propagation queue takes it.
+struct unit_clause {
+  const proof_clause* source;
+  bool unit() const { return true; }
+  branch propagate() const { return {*source->begin(), source}; }
+};
+
+// Unit propagation from nothing assigned, over a watched clause
+// database that changes between checks.
+class propagator {
+public:
+  propagator(size_t variables, size_t clauses) :
+    assignment(variables), decision_level(2*variables), db(conflicts, queue, assignment, decision_level),
+    position(clauses, npos), seen(variables) {
+    db.set_variables(variables);
+    db.reset();
+  }
+  void insert(const proof_clause& c) {
+    if (c.c.width() == 0) empty.push_back(&c);
+    if (c.c.width() == 1) units.push_back(&c);
+    if (c.c.width() == 0) return;
+    position[c.id] = db.size();
+    db.insert(c);
+  }
+  void erase(const proof_clause& c) {
+    if (c.c.width() == 0) empty.erase(find(empty.begin(), empty.end(), &c));
+    if (c.c.width() == 1) units.erase(find(units.begin(), units.end(), &c));
+    if (c.c.width() == 0) return;
+    auto it = db.erase(db.begin() + position[c.id]);
+    // The last clause has been moved into the gap.
+    if (it != db.end()) position[it->source->id] = position[c.id];
+    position[c.id] = npos;
+  }
+  // Whether propagating the negation of c reaches a conflict. If so,
+  // used holds the conflict and the reasons it was derived from.
+  bool rup(const clause& c, vector<const proof_clause*>& used) {
+    used.clear();
+    if (not empty.empty()) {
+      used.push_back(empty.back());
+      return true;
+    }
+    for (literal l : c) queue.decide(~l);
+    for (const proof_clause* u : units) queue.propagate(unit_clause{u});
+    const proof_clause* conflict = NULL;
+    bool tautology = false;
+    while (not queue.empty()) {
+      branch b = queue.front();
+      queue.pop();
+      int a = assignment[variable(b.to)];
+      if (a) {
+        if ((a==1) == b.to.polarity()) continue;
+        // The reason is falsified; two decisions mean that c is a
+        // tautology.
+        if (b.reason) conflict = b.reason;
+        else tautology = true;
+        break;
+      }
+      assignment[variable(b.to)] = b.to.polarity() ? 1 : -1;
+      trail.push_back(b);
+      db.assign(b.to);
+      if (not conflicts.empty()) {
+        conflict = conflicts.front();
+        break;
+      }
+    }
+    if (conflict) analyze(*conflict, used);
+    backtrack();
+    return conflict or tautology;
+  }
+  // Whether every resolvent of c on the pivot with a clause in the
+  // database is RUP. If so, used holds those clauses and the clauses
+  // the resolvents were derived from.
+  bool rat(const clause& c, literal pivot, vector<const proof_clause*>& used) {
+    used.clear();
+    vector<const proof_clause*> candidates, resolvent_used;
+    for (auto it = db.begin(); it != db.end(); ++it) {
+      if (it->source->c.contains(~pivot)) candidates.push_back(it->source);
+    }
+    vector<literal> literals;
+    for (const proof_clause* d : candidates) {
+      literals.assign(c.begin(), c.end());
+      for (literal l : d->c) if (not (l == ~pivot)) literals.push_back(l);
+      if (not rup(normalize(literals), resolvent_used)) return false;
+      used.push_back(d);
+      used.insert(used.end(), resolvent_used.begin(), resolvent_used.end());
+    }
+    return true;
+  }
+private:
+  vector<const proof_clause*> conflicts;
+  propagation_queue queue;
+  vector<int> assignment;
+  vector<int> decision_level;
+  watched_clause_database db;
+  // Index in db, by clause id.
+  vector<size_t> position;
+  // Unit and empty clauses, which propagate without any assignment.
+  vector<const proof_clause*> units;
+  vector<const proof_clause*> empty;
+  branching_sequence trail;
+  vector<char> seen;
+
+  void analyze(const proof_clause& conflict, vector<const proof_clause*>& used) {
+    used.push_back(&conflict);
+    for (literal l : conflict) seen[variable(l)] = true;
+    for (auto it = trail.rbegin(); it != trail.rend(); ++it) {
+      if (not seen[variable(it->to)] or not it->reason) continue;
+      used.push_back(it->reason);
+      for (literal l : *it->reason) seen[variable(l)] = true;
+    }
+  }
+  void backtrack() {
+    for (auto it = trail.rbegin(); it != trail.rend(); ++it) {
+      db.unassign(it->to);
+      assignment[variable(it->to)] = 0;
+      seen[variable(it->to)] = false;
+    }
+    trail.clear();
+    queue.clear();
+    conflicts.clear();
+  }
+};
+
+struct clause_hash {
+  size_t operator () (const clause* c) const { return boost::hash_range(c->begin(), c->end()); }
+};
+struct clause_equal {
+  bool operator () (const clause* a, const clause* b) const { return *a == *b; }
+};
+
+// Checks a DRAT proof backwards from the empty clause, marking the
+// clauses each needed lemma is derived from. A lemma that is not RUP
+// may be RAT on its first literal. The proof is split into
+// one segment per thread, each with its own database that moves
+// through the proof. Marks only go backwards, but a thread may pass
+// a lemma before a later segment marks it, so segments are checked
+// again until no marked lemma is left unchecked.
+class drat_checker {
+public:
+  drat_checker(const cnf& f, istream& proof, bool binary) : axioms(f.clauses.size()),
+                                                            variables(f.variables) {
+    unordered_map<const clause*, vector<size_t>, clause_hash, clause_equal> present;
+    for (const clause& c : f.clauses) add(c, present);
+    drat_reader reader(proof, binary);
+    bool deletion;
+    vector<literal> literals;
+    size_t absent = 0;
+    while (reader.next(deletion, literals)) {
+      for (literal l : literals) variables = max(variables, size_t(variable(l))+1);
+      literal pivot = literals.empty() ? literal::from_raw(0) : literals.front();
+      clause c = normalize(literals);
+      if (not deletion) {
+        steps.push_back({add(c, present), false, pivot});
+        if (not c.width()) break;
+        continue;
+      }
+      auto it = present.find(&c);
+      if (it == present.end()) {
+        ++absent;
+        continue;
+      }
+      steps.push_back({it->second.back(), true, pivot});
+      it->second.pop_back();
+      if (it->second.empty()) present.erase(it);
+    }
+    if (absent) cerr << "Ignored " << absent << " deletions of absent clauses" << endl;
+    // Without the empty clause, the last clauses must propagate to a
+    // conflict.
+    if (steps.empty() or steps.back().deletion or clauses[steps.back().id].c.width()) {
+      steps.push_back({add(clause(vector<literal>()), present), false, literal::from_raw(0)});
+    }
+  }
+
+  bool check(unsigned threads) {
+    needed.reset(new atomic<bool>[clauses.size()]);
+    for (size_t i=0; i<clauses.size(); ++i) needed[i] = false;
+    checked.assign(clauses.size(), false);
+    needed[steps.back().id] = true;
+    size_t n = min<size_t>(thread_count(threads), steps.size());
+    for (size_t i=0; i<n; ++i) {
+      segments.push_back({i*steps.size()/n, (i+1)*steps.size()/n, 0,
+            unique_ptr<propagator>(new propagator(variables, clauses.size()))});
+      for (size_t j=0; j<axioms; ++j) segments.back().p->insert(clauses[j]);
+    }
+    size_t rounds = 0;
+    for (;;) {
+      vector<thread> pool;
+      for (segment& s : segments) {
+        if (not pending(s)) continue;
+        if (segments.size() == 1) run(s);
+        else pool.emplace_back(&drat_checker::run, this, ref(s));
+      }
+      for (thread& t : pool) t.join();
+      if (failed != npos) break;
+      if (all_of(segments.begin(), segments.end(),
+                 [this](const segment& s) { return not pending(s); })) break;
+      ++rounds;
+    }
+    size_t core = count(checked.begin(), checked.end(), true);
+    LOG(LOG_ACTIONS) << "Checked " << core << " of " << clauses.size()-axioms << " lemmas in "
+                     << rounds+1 << " rounds" << endl;
+    if (failed == npos) return true;
+    const clause& c = clauses[failed].c;
+    if (c.width()) cerr << "Lemma " << failed-axioms+1 << " is neither RUP nor RAT: " << c << endl;
+    else cerr << "The empty clause is not RUP" << endl;
+    return false;
+  }
+private:
+  struct step {
+    size_t id;
+    bool deletion;
+    // First literal of a lemma, as written.
+    literal pivot;
+  };
+  struct segment {
+    size_t begin, end;
+    // The database holds the clauses present before this step.
+    size_t at;
+    unique_ptr<propagator> p;
+  };
+  // Formula, then lemmas, by id.
+  arena<proof_clause> clauses;
+  size_t axioms;
+  size_t variables;
+  vector<step> steps;
+  vector<segment> segments;
+  unique_ptr<atomic<bool>[]> needed;
+  // Each lemma is only written by the thread of its segment.
+  vector<char> checked;
+  atomic<size_t> failed{npos};
+
+  size_t add(const clause& c, unordered_map<const clause*, vector<size_t>, clause_hash,
+             clause_equal>& present) {
+    size_t id = clauses.size();
+    proof_clause& pc = clauses.emplace_back(c);
+    pc.id = id;
+    present[&pc.c].push_back(id);
+    return id;
+  }
+  bool pending(const segment& s) const {
+    for (size_t i=s.begin; i<s.end; ++i) {
+      const step& t = steps[i];
+      if (not t.deletion and needed[t.id] and not checked[t.id]) return true;
+    }
+    return false;
+  }
+  void run(segment& s) {
+    propagator& p = *s.p;
+    for (; s.at < s.end; ++s.at) {
+      const step& t = steps[s.at];
+      if (t.deletion) p.erase(clauses[t.id]);
+      else p.insert(clauses[t.id]);
+    }
+    vector<const proof_clause*> used;
+    for (; s.at > s.begin; --s.at) {
+      const step& t = steps[s.at-1];
+      if (t.deletion) {
+        p.insert(clauses[t.id]);
+        continue;
+      }
+      p.erase(clauses[t.id]);
+      if (not needed[t.id] or checked[t.id]) continue;
+      if (failed != npos) return;
+      const clause& c = clauses[t.id].c;
+      if (not p.rup(c, used) and not (c.width() and p.rat(c, t.pivot, used))) {
+        failed = t.id;
+        return;
+      }
+      checked[t.id] = true;
+      for (const proof_clause* c : used) needed[c->id] = true;
+    }
+  }
+};
+
+// Checks LRAT lemmas against their hints. The hints up to the first
+// negative one are kept as the derivation. Each negative hint names a
+// clause containing the negation of the first literal of the lemma,
+// and is followed by the hints for the resolvent with that clause.
+class lrat_checker {
+public:
+  lrat_checker(const cnf& f, istream& proof) : axioms(f.clauses.size()), variables(f.variables) {
+    by_number.push_back(NULL);
+    for (const clause& c : f.clauses) {
+      proof_clause& pc = clauses.emplace_back(c);
+      pc.id = clauses.size()-1;
+      by_number.push_back(&pc);
+      refuted = refuted or not c.width();
+    }
+    vector<literal> literals;
+    while (not refuted and skip_blanks(proof)) {
+      long number = read_number(proof);
+      if (not skip_blanks(proof)) malformed();
+      if (proof.peek() == 'd') {
+        proof.get();
+        for (long x; (x = read_number(proof));) {
+          if (x < 0 or size_t(x) >= by_number.size()) malformed();
+          by_number[x] = NULL;
+        }
+        continue;
+      }
+      literals.clear();
+      for (long x; (x = read_number(proof));) {
+        literals.push_back(literal::from_dimacs(x));
+        variables = max(variables, size_t(variable(literals.back()))+1);
+      }
+      rat_hints r;
+      if (not literals.empty()) r.pivot = literals.front();
+      proof_clause& pc = clauses.emplace_back(normalize(literals));
+      pc.id = clauses.size()-1;
+      for (long x; (x = read_number(proof));) {
+        size_t n = labs(x);
+        if (error.empty() and (n >= by_number.size() or not by_number[n])) {
+          error = "Lemma " + to_string(number) + " uses clause " + to_string(n) +
+            ", which is not present";
+        }
+        if (not error.empty()) continue;
+        if (x < 0) r.groups.push_back({by_number[n], {}});
+        else if (r.groups.empty()) pc.derivation.push_back(by_number[n]);
+        else r.groups.back().hints.push_back(by_number[n]);
+      }
+      if (error.empty() and number < long(by_number.size())) {
+        error = "Lemma " + to_string(number) + " is not numbered after the previous clauses";
+      }
+      if (error.empty() and not r.groups.empty()) error = missing_rat_hints(number, pc, r);
+      if (not error.empty()) return;
+      rats.push_back(std::move(r));
+      by_number.resize(number+1);
+      by_number[number] = &pc;
+      numbers.push_back(number);
+      refuted = not pc.c.width();
+    }
+  }
+
+  bool check(unsigned threads) {
+    if (not error.empty()) {
+      cerr << error << endl;
+      return false;
+    }
+    size_t lemmas = clauses.size()-axioms;
+    size_t n = max<size_t>(1, min<size_t>(thread_count(threads), lemmas));
+    vector<size_t> failures(n, npos);
+    auto run = [this, &failures, lemmas, n](size_t i) {
+      vector<int> assignment(variables);
+      vector<variable> trail;
+      for (size_t j=axioms+i*lemmas/n; j<axioms+(i+1)*lemmas/n; ++j) {
+        if (not implied(clauses[j], rats[j-axioms], assignment, trail)) {
+          failures[i] = j;
+          return;
+        }
+      }
+    };
+    if (n == 1) run(0);
+    else {
+      vector<thread> pool;
+      for (size_t i=0; i<n; ++i) pool.emplace_back(run, i);
+      for (thread& t : pool) t.join();
+    }
+    LOG(LOG_ACTIONS) << "Checked " << lemmas << " lemmas" << endl;
+    auto failure = find_if(failures.begin(), failures.end(), [](size_t j) { return j != npos; });
+    if (failure != failures.end()) {
+      cerr << "Lemma " << numbers[*failure-axioms] << " is not implied by its hints" << endl;
+      return false;
+    }
+    if (not refuted) cerr << "The proof does not derive the empty clause" << endl;
+    return refuted;
+  }
+private:
+  // Formula, then lemmas.
+  arena<proof_clause> clauses;
+  size_t axioms;
+  size_t variables;
+  // Present clauses by LRAT number.
+  vector<const proof_clause*> by_number;
+  // LRAT number of each lemma.
+  vector<long> numbers;
+  struct rat_hints {
+    literal pivot = literal::from_raw(0);
+    struct group {
+      const proof_clause* clause;
+      vector<const proof_clause*> hints;
+    };
+    vector<group> groups;
+  };
+  // RAT hints of each lemma, empty for RUP lemmas.
+  vector<rat_hints> rats;
+  bool refuted = false;
+  string error;
+
+  // Every present clause containing the negation of the pivot needs
+  // hints for its resolvent with the lemma.
+  string missing_rat_hints(long number, const proof_clause& c, const rat_hints& r) const {
+    if (not c.c.width()) return "Lemma " + to_string(number) + " has RAT hints but no pivot";
+    for (size_t n=1; n<by_number.size(); ++n) {
+      const proof_clause* d = by_number[n];
+      if (not d or not d->c.contains(~r.pivot)) continue;
+      if (none_of(r.groups.begin(), r.groups.end(),
+                  [d](const rat_hints::group& g) { return g.clause == d; })) {
+        return "Lemma " + to_string(number) + " has no RAT hints for clause " + to_string(n);
+      }
+    }
+    return "";
+  }
+
+  // Each hint must be unit under the negation of c and the units
+  // before it, until one is falsified. Otherwise, the negation of the
+  // resolvent with each clause of a RAT group must be falsified in the
+  // same way by the hints of the group.
+  static bool implied(const proof_clause& c, const rat_hints& r,
+                      vector<int>& assignment, vector<variable>& trail) {
+    auto falsify = [&assignment, &trail](literal l) {
+      assignment[variable(l)] = l.polarity() ? -1 : 1;
+      trail.push_back(variable(l));
+    };
+    auto value = [&assignment](literal l) {
+      int a = assignment[variable(l)];
+      return l.polarity() ? a : -a;
+    };
+    // Whether the hints reach a conflict by unit propagation.
+    auto propagate = [&falsify, &value](const vector<const proof_clause*>& hints) {
+      for (const proof_clause* d : hints) {
+        const literal* unit = NULL;
+        size_t unassigned = 0;
+        for (const literal& l : *d) {
+          if (value(l) > 0) unassigned = 2;
+          else if (value(l) == 0) {
+            ++unassigned;
+            unit = &l;
+          }
+          if (unassigned > 1) break;
+        }
+        if (unassigned > 1) return false;
+        if (unassigned == 0) return true;
+        falsify(~*unit);
+      }
+      return false;
+    };
+    bool ret = false;
+    for (literal l : c) {
+      if (value(l) < 0) continue;
+      // A tautology.
+      if (value(l) > 0) ret = true;
+      else falsify(l);
+    }
+    if (not ret) ret = propagate(c.derivation);
+    if (not ret and not r.groups.empty()) {
+      size_t units = trail.size();
+      ret = true;
+      for (const auto& g : r.groups) {
+        bool conflict = false;
+        for (literal l : g.clause->c) {
+          if (l == ~r.pivot) continue;
+          if (value(l) > 0) conflict = true;
+          else if (value(l) == 0) falsify(l);
+        }
+        if (not conflict) conflict = propagate(g.hints);
+        for (size_t i=units; i<trail.size(); ++i) assignment[trail[i]] = 0;
+        trail.resize(units);
+        if (not conflict) {
+          ret = false;
+          break;
+        }
+      }
+    }
+    for (variable x : trail) assignment[x] = 0;
+    trail.clear();
+    return ret;
+  }
+};
+
+}
+
+bool check_drat(const cnf& f, istream& proof, bool binary, unsigned threads) {
+  drat_checker checker(f, proof, binary);
+  return checker.check(threads);
+}
+
+bool check_lrat(const cnf& f, istream& proof, unsigned threads) {
+  lrat_checker checker(f, proof);
+  return checker.check(threads);
+}
+
+bool check_proof(const cnf& f, const string& path, unsigned threads) {
+  bool binary = path.size() >= 5 and path.compare(path.size()-5, 5, ".drat") == 0;
+  ifstream proof(path, binary ? ios::binary : ios::in);
+  if (not proof) {
+    cerr << "Could not open " << path << endl;
+    exit(1);
+  }
+  if (path.size() >= 5 and path.compare(path.size()-5, 5, ".lrat") == 0) {
+    return check_lrat(f, proof, threads);
+  }
+  return check_drat(f, proof, binary, threads);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <istream>
+#include <string>
+
+#include "data_structures.h"
+
+// Proof checking: a proof is verified if it derives the empty clause
+// from the formula. Lemmas may be RUP or RAT, with the first literal
+// of the lemma as the pivot. The checkers use threads=0 for one per
+// core.
+
+// DRAT, in the textual or in the binary format. Lemmas are checked
+// backwards from the empty clause, so only those it depends on are
+// checked, by several threads working on consecutive parts of the
+// proof.
+bool check_drat(const cnf& f, std::istream& proof, bool binary, unsigned threads = 0);
+// LRAT. Lemmas are checked against their hints by several threads.
+bool check_lrat(const cnf& f, std::istream& proof, unsigned threads = 0);
+// In the format given by the extension of path, as for --proof-dag.
+bool check_proof(const cnf& f, const std::string& path, unsigned threads = 0);
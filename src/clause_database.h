@@ -16,6 +16,8 @@ struct clause_database_i {
   virtual void assign(literal l)=0;
   virtual void unassign(literal l)=0;
   virtual void reset()=0;
+  // Remove every clause.
+  virtual void clear()=0;
   virtual void fill_propagation_queue()=0;
 
   virtual void insert(const proof_clause& c)=0;
@@ -26,10 +28,17 @@ struct clause_database_i {
   virtual clause_iterator begin() const =0;
   virtual clause_iterator end() const =0;
   virtual clause_iterator erase(clause_iterator)=0;
+  // Replace a clause by c, which must not be satisfied nor falsified
+  // by the current assignment.
+  virtual void replace(clause_iterator, const proof_clause& c)=0;
   const clause_pointer& back() const { return *(end()-1); }
   size_t size() const { return end()-begin(); }
 
   virtual bool consistent() const =0;
+
+  // Bytes used by the working clauses and by the watch lists.
+  virtual size_t memory() const =0;
+  virtual size_t watch_memory() const { return 0; }
 };
 
 
@@ -59,6 +68,7 @@ public:
     assert(working_clauses.back().unit());
   }
   virtual void fill_propagation_queue();
+  virtual void clear() { working_clauses.clear(); }
 
   virtual clause_iterator begin() const { return working_clauses.begin(); }
   virtual clause_iterator end() const { return working_clauses.end(); }
@@ -68,10 +78,20 @@ public:
     working_clauses.pop_back();
     return it;
   }
+  virtual void replace(clause_iterator it, const proof_clause& c) {
+    T& d = it.dereference_as<T>();
+    d = T(c);
+    d.restrict_falsified(assignment, decision_level);
+  }
   virtual bool consistent() const {
     for (auto& c : working_clauses) {
       assert(not c.contradiction());
     }
     return true;
   }
+  virtual size_t memory() const {
+    size_t ret = working_clauses.capacity()*sizeof(T);
+    for (const auto& c : working_clauses) ret += c.memory();
+    return ret;
+  }
 };
@@ -9,18 +9,21 @@ clause clause::from_dimacs(std::initializer_list<int> x) {
   clause ret;
   transform(x.begin(), x.end(), back_inserter(ret.literals), literal::from_dimacs);
   sort(ret.literals.begin(), ret.literals.end());
+  ret.signature = literal_signature(ret.literals);
   return ret;
 }
 
 bool clause::subsumes(const clause& c) const {
   assert(is_sorted(literals.begin(), literals.end()));
   assert(is_sorted(c.literals.begin(), c.literals.end()));
+  if (signature & ~c.signature) return false;
   return includes(c.literals.begin(), c.literals.end(), literals.begin(), literals.end());
 }
 
 bool clause::subsumes(const clause& c, literal l) const {
   assert(is_sorted(literals.begin(), literals.end()));
   assert(is_sorted(c.literals.begin(), c.literals.end()));
+  if (signature & ~(c.signature | literal_bit(l))) return false;
   for (auto it = c.begin(), jt = begin(); jt!=end(); ++it) {
     if (*jt==l) {
       ++jt;
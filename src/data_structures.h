@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <list>
@@ -7,6 +9,8 @@
 
 #include <boost/functional/hash.hpp>
 
+#include "arena.h"
+
 typedef unsigned int variable;
 
 struct literal {
@@ -50,7 +54,8 @@ namespace boost {
 struct clause {
   // Sorted vector
   clause() {}
-  clause(std::vector<literal> from_literals) : literals(from_literals) {}
+  clause(std::vector<literal> from_literals) : literals(std::move(from_literals)),
+                                               signature(literal_signature(literals)) {}
   static clause from_dimacs(std::initializer_list<int> x);
   bool subsumes(const clause& c) const;
   bool subsumes(const clause& c, literal l) const;
@@ -68,8 +73,32 @@ struct clause {
   };
   variable_iterator dom_begin() const { return literals.begin(); }
   variable_iterator dom_end() const { return literals.end(); }
+  // Heap bytes owned by the clause.
+  std::size_t memory() const { return literals.capacity()*sizeof(literal); }
+  // Signatures are a cheap filter for set comparisons: if one clause
+  // is a subset of another, so is its signature. Literal l sets bit
+  // l%64, so both polarities of a variable share a pair of bits.
+  static uint64_t literal_bit(literal l) { return uint64_t(1) << (l.l & 63); }
+  static uint64_t variable_bits(variable x) { return uint64_t(3) << ((x & 31) << 1); }
+  static uint64_t literal_signature(const std::vector<literal>& literals) {
+    uint64_t ret = 0;
+    for (literal l : literals) ret |= literal_bit(l);
+    return ret;
+  }
+  static uint64_t domain_signature(const std::vector<variable>& domain) {
+    uint64_t ret = 0;
+    for (variable x : domain) ret |= variable_bits(x);
+    return ret;
+  }
+  uint64_t literal_signature() const { return signature; }
+  uint64_t domain_signature() const {
+    const uint64_t even = 0x5555555555555555;
+    uint64_t any = (signature | (signature >> 1)) & even;
+    return any | (any << 1);
+  }
 private:
   std::vector<literal> literals;
+  uint64_t signature = 0;
   friend struct std::hash<clause>;
 };
 clause resolve(const clause& c, const clause& d, variable x);
@@ -83,10 +112,16 @@ namespace std {
   };
 };
 
+// Formulas can be large, so they are moved rather than copied.
 struct cnf {
   std::vector<clause> clauses;
-  int variables;
+  int variables = 0;
   std::unordered_map<int,std::string> variable_names;
+  cnf() {}
+  cnf(const cnf&) = delete;
+  cnf& operator = (const cnf&) = delete;
+  cnf(cnf&&) = default;
+  cnf& operator = (cnf&&) = default;
 };
 
 struct proof_clause;
@@ -96,11 +131,39 @@ struct branch {
 };
 typedef std::vector<branch> branching_sequence;
 
+// Branching sequences stored as a tree of their prefixes, so that
+// consecutive trails share their common part.
+struct trail_store {
+  static constexpr size_t root = -1;
+  struct node {
+    branch b;
+    size_t parent;
+  };
+  std::vector<node> nodes;
+  size_t push(const branch& b, size_t parent) {
+    nodes.push_back({b, parent});
+    return nodes.size()-1;
+  }
+  size_t memory() const { return nodes.capacity()*sizeof(node); }
+  branching_sequence trail(size_t leaf) const {
+    branching_sequence ret;
+    for (; leaf != root; leaf = nodes[leaf].parent) ret.push_back(nodes[leaf].b);
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+  }
+};
+
 struct proof_clause {
   clause c;
   std::vector<const proof_clause*> derivation;
-  branching_sequence trail;
+  // Last node of the branching sequence at the time the clause was
+  // learnt, if trails are recorded.
+  size_t trail = trail_store::root;
+  // Dense index: formula clauses first, then lemmas in the order they
+  // were learnt.
+  size_t id = 0;
   proof_clause(const clause& from_c) : c(from_c) {}
+  proof_clause(clause&& from_c) : c(std::move(from_c)) {}
   proof_clause(const proof_clause&) = delete;
   proof_clause(proof_clause&&) = default;
   void resolve(const proof_clause& d, int x) {
@@ -109,15 +172,73 @@ struct proof_clause {
   }
   std::vector<literal>::const_iterator begin() const { return c.begin(); }
   std::vector<literal>::const_iterator end() const { return c.end(); }
+  // Heap bytes owned by the clause.
+  size_t memory() const {
+    return c.memory() + derivation.capacity()*sizeof(const proof_clause*);
+  }
 };
 
 struct proof {
   std::vector<proof_clause> formula;
-  std::list<proof_clause> resolution;
+  arena<proof_clause> resolution;
+  trail_store trails;
   proof(const proof&) = delete;
   proof& operator = (const proof&) = delete;
+  proof() {}
   proof(proof&&) = default;
+  proof& operator = (proof&&) = default;
   proof(std::vector<proof_clause>&& from_formula,
-        std::list<proof_clause>&& from_resolution) :
-  formula(std::move(from_formula)), resolution(std::move(from_resolution)) {}
+        arena<proof_clause>&& from_resolution,
+        trail_store&& from_trails) :
+  formula(std::move(from_formula)), resolution(std::move(from_resolution)),
+  trails(std::move(from_trails)) {}
+};
+
+// Heap bytes used by each part of the solver. Container overhead is
+// estimated from capacities, and node-based containers from their
+// size.
+struct memory_usage {
+  size_t formula = 0;
+  // Lemmas, their derivations and trails.
+  size_t learnt = 0;
+  // Working copies of the clauses.
+  size_t working = 0;
+  size_t watches = 0;
+  size_t reasons = 0;
+  size_t decision_order = 0;
+  // Per-clause and per-variable bookkeeping.
+  size_t metadata = 0;
+  // Branching sequence, propagation queue and per-variable state.
+  size_t assignment = 0;
+
+  size_t total() const {
+    return formula + learnt + working + watches + reasons + decision_order + metadata + assignment;
+  }
+  // Component-wise maximum.
+  memory_usage& operator |= (const memory_usage& other);
+};
+
+struct solver_stats {
+  int decisions = 0, propagations = 0, conflicts = 0, restarts = 0;
+  // Sampling points, at the start and after each conflict, after which
+  // the invariants were checked.
+  int verified = 0;
+  // Antecedents replaced or removed by on-the-fly strengthening.
+  int strengthened = 0;
+  // Learnt clauses removed by the forgetting schema.
+  int forgotten = 0;
+  // Periodic reductions of the learnt clauses.
+  int reductions = 0;
+};
+
+// Outcome of solving a formula: a model if it is satisfiable, or a
+// refutation if it is not.
+struct result {
+  bool sat = false;
+  solver_stats stats;
+  // Memory in use when the search ended.
+  memory_usage memory;
+  // Indexed by variable number. Values are 1 (true) or -1 (false).
+  std::vector<int> model;
+  struct proof proof;
 };
@@ -1,87 +1,457 @@
 #include "dimacs.h"
 
-#include <sstream>
+#include <algorithm>
 #include <cassert>
-#include <set>
+#include <cctype>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <lzma.h>
+#include <zlib.h>
 using namespace std;
 
+// Scans DIMACS input in place, one piece at a time. Each clause is
+// one line; anything after the terminating zero is ignored.
 class parser {
 public:
-  parser(istream& in);
-  operator cnf() { return f; }
+  // At most size_hint/2 clauses are reserved up front, whatever the
+  // header says.
+  parser(size_t size_hint);
+  // Parser for a piece of the body starting at line lineno, once
+  // header has read the header. Its warnings are held back until it
+  // is appended.
+  parser(const parser& header, int lineno);
+  // Parses [begin, end), which must not split a line.
+  void parse(const char* begin, const char* end);
+  // Parses lines of [begin, end) up to the header, and returns where
+  // the body starts.
+  const char* parse_header(const char* begin, const char* end);
+  // Takes the clauses and warnings of the next piece of the body.
+  void append(parser& piece);
+  int line() const { return lineno; }
+  cnf finish();
 private:
   cnf f;
-  istream& in;
+  size_t size_hint;
+  std::ostream* warnings;
+  std::ostringstream held_warnings;
+  const char* p;
+  const char* end;
   int& nvars;
   int nclauses;
+  bool header;
   unordered_map<int, string>& variable_names;
   int lineno;
-  void parse_header();
-  void parse_body();
+  // Literals of the clause being parsed, reused across clauses.
+  vector<literal> buffer;
+  void parse_header_line();
+  void parse_body_line();
+  void parse_clause();
+
+  bool at_eol() const { return p==end or *p=='\n'; }
+  void skip_blanks() {
+    while (p!=end and (*p==' ' or *p=='\t' or *p=='\r')) ++p;
+  }
+  void skip_line() {
+    p = find(p, end, '\n');
+    if (p!=end) ++p;
+    ++lineno;
+  }
+  bool scan_int(int& x);
+  string scan_word();
 };
 
 #define ERROR(message) {\
     cerr << "Error on line " << lineno << ": " << message << endl;\
     exit(1);}
 #define WARNING(message) {\
-    cerr << "Warning on line " << lineno << ": " << message << endl;}
-
-void parser::parse_header() {
-  string s;
-  for (; getline(in, s); ++lineno) {
-    if (s.empty()) continue;
-    if (s[0]=='c') {
-      stringstream ss(s);
-      char c;
-      int varnum;
-      string label,varname;
-      ss >> c >> label >> varnum >> varname;
-      if (label=="varname") variable_names[varnum-1]=varname;
+    *warnings << "Warning on line " << lineno << ": " << message << endl;}
+
+// Reads an optionally signed integer. Leaves p untouched if there is
+// none.
+bool parser::scan_int(int& x) {
+  const char* q = p;
+  bool negative = (q!=end and *q=='-');
+  if (negative) ++q;
+  if (q==end or *q<'0' or *q>'9') return false;
+  long long y = 0;
+  for (; q!=end and *q>='0' and *q<='9'; ++q) y = y*10 + (*q-'0');
+  if (y > numeric_limits<int>::max()) ERROR("number out of range");
+  x = negative ? -y : y;
+  p = q;
+  return true;
+}
+
+string parser::scan_word() {
+  const char* q = p;
+  while (p!=end and not isspace((unsigned char)*p)) ++p;
+  return string(q, p);
+}
+
+void parser::parse_header_line() {
+  skip_blanks();
+  if (at_eol()) return;
+  if (*p=='c') {
+    ++p;
+    skip_blanks();
+    int varnum;
+    if (scan_word()=="varname" and (skip_blanks(), scan_int(varnum))) {
+      skip_blanks();
+      variable_names[varnum-1] = scan_word();
     }
-    else break;
-  }
-  istringstream ss(s);
-  char p;
-  string t;
-  ss >> p >> t >> nvars >> nclauses;
-  if (p!='p' or t!="cnf") ERROR("header not found");
-}
-
-void parser::parse_body() {
-  string s;
-  for (; getline(in, s); ++lineno) {
-    if (s.empty()) continue;
-    if (s[0]=='c') continue;
-    istringstream ss(s);
-    set<literal> c;
-    int x;
-    while(ss >> x and x) {
-      literal l=literal::from_dimacs(x);
-      if (c.count(l)) WARNING("repeated literal " << x);
-      if (c.count(~l)) WARNING("opposite literals " << x << " and " << (~x));
-      variable v=variable(l);
-      if (v >= nvars) {
-        WARNING("variable " << v << " out of range");
-        nvars=v+1;
-      }
-      c.insert(l);
+    return;
+  }
+  header = (*p=='p');
+  if (header) {
+    ++p;
+    skip_blanks();
+    header = (scan_word()=="cnf");
+    skip_blanks();
+    header = header and scan_int(nvars);
+    skip_blanks();
+    header = header and scan_int(nclauses);
+  }
+  if (not header) ERROR("header not found");
+  // Every clause takes at least two bytes, so a bogus header cannot
+  // make us reserve more than the input justifies.
+  f.clauses.reserve(min<size_t>(max(nclauses, 0), size_hint/2+1));
+}
+
+void parser::parse_clause() {
+  buffer.clear();
+  int x;
+  while (true) {
+    skip_blanks();
+    if (at_eol()) ERROR("not zero-terminated");
+    // Like an istream, stop at anything that is not a number.
+    if (not scan_int(x) or x==0) break;
+    literal l = literal::from_dimacs(x);
+    variable v = variable(l);
+    if (v >= variable(nvars)) {
+      WARNING("variable " << v << " out of range");
+      nvars = v+1;
     }
-    if (x!=0) ERROR("not zero-terminated");
-    f.clauses.push_back(vector<literal>(c.begin(), c.end()));
+    buffer.push_back(l);
+  }
+  sort(buffer.begin(), buffer.end());
+  for (size_t i=1; i<buffer.size(); ++i) {
+    literal l = buffer[i];
+    int x = (l.polarity() ? 1 : -1) * int(variable(l)+1);
+    if (l==buffer[i-1]) WARNING("repeated literal " << x);
+    if (l.opposite(buffer[i-1])) WARNING("opposite literals " << -x << " and " << x);
   }
-  if (f.clauses.size() != nclauses) {
+  f.clauses.emplace_back(vector<literal>(buffer.begin(), unique(buffer.begin(), buffer.end())));
+}
+
+void parser::parse_body_line() {
+  skip_blanks();
+  if (at_eol() or *p=='c') return;
+  parse_clause();
+}
+
+void parser::parse(const char* begin, const char* end) {
+  p = begin;
+  this->end = end;
+  for (; p!=end; skip_line()) {
+    if (header) parse_body_line();
+    else parse_header_line();
+  }
+}
+
+cnf parser::finish() {
+  if (not header) ERROR("header not found");
+  if (f.clauses.size() != size_t(nclauses)) {
     WARNING("expected " << nclauses << " clauses but read " << f.clauses.size());
   }
+  return std::move(f);
+}
+
+const char* parser::parse_header(const char* begin, const char* end) {
+  p = begin;
+  this->end = end;
+  for (; p!=end and not header; skip_line()) parse_header_line();
+  return p;
+}
+
+void parser::append(parser& piece) {
+  *warnings << piece.held_warnings.str();
+  nvars = max(nvars, piece.nvars);
+  move(piece.f.clauses.begin(), piece.f.clauses.end(), back_inserter(f.clauses));
+  piece.f.clauses.clear();
+}
+
+parser::parser(size_t size_hint) :
+  size_hint(size_hint), warnings(&cerr), nvars(f.variables), nclauses(0), header(false),
+  variable_names(f.variable_names), lineno(1) {}
+
+parser::parser(const parser& header, int lineno) :
+  size_hint(0), warnings(&held_warnings), nvars(f.variables), nclauses(0), header(true),
+  variable_names(f.variable_names), lineno(lineno) {
+  nvars = header.nvars;
+}
+
+// Bodies are only split if every thread gets at least this many
+// bytes.
+static const size_t min_piece_size = 1<<22;
+
+cnf parse_dimacs(const char* begin, const char* end, unsigned threads) {
+  parser parser(end-begin);
+  const char* body = parser.parse_header(begin, end);
+  if (threads == 0) {
+    threads = min<size_t>(thread::hardware_concurrency(), (end-body)/min_piece_size);
+  }
+  if (threads <= 1) {
+    parser.parse(body, end);
+    return parser.finish();
+  }
+  // Split the body at line boundaries.
+  vector<const char*> bounds = {body};
+  for (unsigned i=1; i<threads; ++i) {
+    const char* b = find(max(bounds.back(), body + (end-body)*i/threads), end, '\n');
+    bounds.push_back(b==end ? end : b+1);
+  }
+  bounds.push_back(end);
+  vector<unique_ptr<class parser>> pieces;
+  int lineno = parser.line();
+  for (unsigned i=0; i<threads; ++i) {
+    pieces.emplace_back(new class parser(parser, lineno));
+    lineno += count(bounds[i], bounds[i+1], '\n');
+  }
+  vector<thread> workers;
+  for (unsigned i=0; i<threads; ++i) {
+    workers.emplace_back([&, i]() { pieces[i]->parse(bounds[i], bounds[i+1]); });
+  }
+  for (auto& worker : workers) worker.join();
+  for (auto& piece : pieces) parser.append(*piece);
+  return parser.finish();
+}
+
+// Feeds the parser whole lines from read(buffer, n), which returns
+// the number of bytes it stored, or 0 at the end of the input.
+template<typename Read>
+static cnf parse_stream(Read read, size_t size_hint = 1<<24) {
+  parser parser(size_hint);
+  vector<char> buffer(1<<20);
+  size_t filled = 0;
+  while (true) {
+    // A line longer than the buffer.
+    if (filled == buffer.size()) buffer.resize(2*buffer.size());
+    size_t n = read(buffer.data()+filled, buffer.size()-filled);
+    if (n==0) break;
+    filled += n;
+    size_t lines = filled;
+    while (lines and buffer[lines-1]!='\n') --lines;
+    parser.parse(buffer.data(), buffer.data()+lines);
+    copy(buffer.begin()+lines, buffer.begin()+filled, buffer.begin());
+    filled -= lines;
+  }
+  parser.parse(buffer.data(), buffer.data()+filled);
+  return parser.finish();
 }
 
-parser::parser(istream& in) :
-  in(in), nvars(f.variables),
-  variable_names(f.variable_names), lineno(1) {
-  parse_header();
-  parse_body();
+static cnf parse_gzip(int fd, const string& path) {
+  gzFile in = gzdopen(fd, "rb");
+  if (not in) {
+    cerr << "Could not open " << path << endl;
+    exit(1);
+  }
+  gzbuffer(in, 1<<18);
+  cnf f = parse_stream([&](char* buffer, size_t n) {
+      int read = gzread(in, buffer, n);
+      if (read < 0) {
+        int error;
+        cerr << "Error decompressing " << path << ": " << gzerror(in, &error) << endl;
+        exit(1);
+      }
+      return size_t(read);
+    });
+  gzclose(in);
+  return f;
+}
+
+static cnf parse_xz(int fd, const string& path) {
+  lzma_stream stream = LZMA_STREAM_INIT;
+  if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+    cerr << "Could not initialize the xz decoder" << endl;
+    exit(1);
+  }
+  vector<uint8_t> input(1<<18);
+  bool done = false;
+  cnf f = parse_stream([&](char* buffer, size_t n) {
+      stream.next_out = reinterpret_cast<uint8_t*>(buffer);
+      stream.avail_out = n;
+      while (stream.avail_out == n and not done) {
+        lzma_action action = LZMA_RUN;
+        if (stream.avail_in == 0) {
+          ssize_t read_in = read(fd, input.data(), input.size());
+          if (read_in < 0) read_in = 0;
+          stream.next_in = input.data();
+          stream.avail_in = read_in;
+          if (read_in == 0) action = LZMA_FINISH;
+        }
+        lzma_ret ret = lzma_code(&stream, action);
+        if (ret == LZMA_STREAM_END) done = true;
+        else if (ret != LZMA_OK) {
+          cerr << "Error decompressing " << path << endl;
+          exit(1);
+        }
+      }
+      return n - stream.avail_out;
+    });
+  lzma_end(&stream);
+  close(fd);
+  return f;
+}
+
+void write_dimacs(ostream& out, const cnf& f) {
+  map<int, string> names(f.variable_names.begin(), f.variable_names.end());
+  for (const auto& name : names) out << "c varname " << name.first+1 << ' ' << name.second << '\n';
+  out << "p cnf " << f.variables << ' ' << f.clauses.size() << '\n';
+  for (const auto& c : f.clauses) {
+    for (literal l : c) out << (l.polarity() ? "" : "-") << variable(l)+1 << ' ';
+    out << "0\n";
+  }
+}
+
+/*
+ * Binary format
+ */
+
+// Layout: the header, then clauses+1 offsets into the literal array,
+// the literal array, and each variable name as its variable number,
+// its length and its bytes. Numbers are in native byte order.
+struct binary_header {
+  char magic[8];
+  uint64_t variables, clauses, literals, names;
+};
+static const char binary_magic[8] = "SATCNF1";
+
+void write_binary_cnf(ostream& out, const cnf& f) {
+  binary_header h;
+  memcpy(h.magic, binary_magic, sizeof(h.magic));
+  h.variables = f.variables;
+  h.clauses = f.clauses.size();
+  h.literals = 0;
+  for (const auto& c : f.clauses) h.literals += c.width();
+  h.names = f.variable_names.size();
+  out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  uint64_t offset = 0;
+  out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+  for (const auto& c : f.clauses) {
+    offset += c.width();
+    out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+  }
+  static_assert(sizeof(literal) == sizeof(uint32_t), "literals are stored as 32-bit words");
+  for (const auto& c : f.clauses) {
+    if (c.width()) out.write(reinterpret_cast<const char*>(&*c.begin()), c.width()*sizeof(literal));
+  }
+  // Sorted, so that equal formulas give equal files.
+  map<int, string> names(f.variable_names.begin(), f.variable_names.end());
+  for (const auto& name : names) {
+    uint32_t header[2] = {uint32_t(name.first), uint32_t(name.second.size())};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(name.second.data(), name.second.size());
+  }
+}
+
+static bool is_binary_cnf(const char* begin, const char* end) {
+  return size_t(end-begin) >= sizeof(binary_header) and
+    memcmp(begin, binary_magic, sizeof(binary_magic)) == 0;
+}
+
+static cnf load_binary_cnf(const char* begin, const char* end, const string& path) {
+  auto corrupt = [&]() {
+    cerr << "Corrupt binary formula " << path << endl;
+    exit(1);
+  };
+  binary_header h;
+  memcpy(&h, begin, sizeof(h));
+  size_t size = end-begin;
+  if (h.clauses >= size/sizeof(uint64_t) or h.literals > size/sizeof(uint32_t) or
+      h.variables > size_t(numeric_limits<int>::max())) corrupt();
+  const uint64_t* offsets = reinterpret_cast<const uint64_t*>(begin+sizeof(h));
+  const uint32_t* literals = reinterpret_cast<const uint32_t*>(offsets+h.clauses+1);
+  const char* p = reinterpret_cast<const char*>(literals+h.literals);
+  if (p > end or offsets[0] != 0 or offsets[h.clauses] != h.literals) corrupt();
+  cnf f;
+  f.variables = h.variables;
+  f.clauses.reserve(h.clauses);
+  for (size_t i=0; i<h.clauses; ++i) {
+    if (offsets[i+1] < offsets[i] or offsets[i+1] > h.literals) corrupt();
+    vector<literal> c;
+    c.reserve(offsets[i+1]-offsets[i]);
+    for (size_t j=offsets[i]; j<offsets[i+1]; ++j) {
+      literal l = literal::from_raw(literals[j]);
+      if (variable(l) >= h.variables) corrupt();
+      c.push_back(l);
+    }
+    f.clauses.emplace_back(std::move(c));
+  }
+  for (size_t i=0; i<h.names; ++i) {
+    uint32_t header[2];
+    if (size_t(end-p) < sizeof(header)) corrupt();
+    memcpy(header, p, sizeof(header));
+    p += sizeof(header);
+    if (size_t(end-p) < header[1]) corrupt();
+    f.variable_names[header[0]] = string(p, header[1]);
+    p += header[1];
+  }
+  return f;
 }
 
 cnf parse_dimacs(istream& in) {
-  return parser(in);
+  return parse_stream([&](char* buffer, size_t n) {
+      in.read(buffer, n);
+      return size_t(in.gcount());
+    });
+}
+
+cnf parse_dimacs_file(const string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    cerr << "Could not open " << path << endl;
+    exit(1);
+  }
+  unsigned char magic[6] = {};
+  ssize_t magic_size = pread(fd, magic, sizeof(magic), 0);
+  if (magic_size >= 2 and magic[0]==0x1f and magic[1]==0x8b) {
+    return parse_gzip(fd, path);
+  }
+  const unsigned char xz_magic[6] = {0xfd, '7', 'z', 'X', 'Z', 0};
+  if (magic_size == 6 and equal(magic, magic+6, xz_magic)) {
+    return parse_xz(fd, path);
+  }
+  struct stat st;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &st)==0 and S_ISREG(st.st_mode) and st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  if (data == MAP_FAILED) {
+    // Pipes, empty files and the like.
+    cnf f = parse_stream([&](char* buffer, size_t n) {
+        ssize_t r = read(fd, buffer, n);
+        return size_t(max<ssize_t>(r, 0));
+      });
+    close(fd);
+    return f;
+  }
+  close(fd);
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  const char* begin = static_cast<const char*>(data);
+  cnf f = is_binary_cnf(begin, begin+st.st_size) ?
+    load_binary_cnf(begin, begin+st.st_size, path) :
+    parse_dimacs(begin, begin+st.st_size);
+  munmap(data, st.st_size);
+  return f;
 }
@@ -3,5 +3,19 @@
 #include "data_structures.h"
 
 #include <istream>
+#include <ostream>
+#include <string>
 
 cnf parse_dimacs(std::istream& in);
+// Large bodies are split at line boundaries and parsed by several
+// threads; threads=0 uses one per core.
+cnf parse_dimacs(const char* begin, const char* end, unsigned threads = 0);
+// Maps the file into memory if possible. Also reads gzip and xz
+// compressed files, and files written by write_binary_cnf.
+cnf parse_dimacs_file(const std::string& path);
+
+void write_dimacs(std::ostream& out, const cnf& f);
+
+// Binary form of a parsed formula, which parse_dimacs_file loads
+// without parsing.
+void write_binary_cnf(std::ostream& out, const cnf& f);
@@ -1,3 +1,3 @@
 #include "formatting.h"
 
-pretty_ pretty;
+thread_local pretty_ pretty;
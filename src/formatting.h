@@ -58,7 +58,9 @@ private:
   friend pretty_& operator << (std::ostream& o, pretty_& p);
 };
 inline pretty_& operator << (std::ostream& o, pretty_& p) { p.o=&o; return p; }
-extern pretty_ pretty;
+// One per thread, so that solvers in different threads may name
+// variables differently.
+extern thread_local pretty_ pretty;
 
 inline std::ostream& operator << (std::ostream& o, literal l) {
   return o << pretty << l;
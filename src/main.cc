@@ -4,8 +4,11 @@
 #include <signal.h>
 
 #include "dimacs.h"
+#include "checker.h"
 #include "solver.h"
 #include "analysis.h"
+#include "proof_writer.h"
+#include "async_stream.h"
 #include "log.h"
 #ifndef NO_VIZ
 #include "vizpebble.h"
@@ -23,12 +26,15 @@ static argp_option options[] = {
    "Use the specified restart interval (default: none)"},
   {"learn", 'l', "{1uip,1uip-all,lastuip,decision}", 0,
    "Use the specified learning schema (default: 1uip)"},
-  {"forget", 'f', "{nothing,everything,wide}", 0,
+  {"forget", 'f', "{nothing,everything,wide,reduce}", 0,
    "Use the specified forgetting schema (default: nothing)"},
   {"watch", 'w', "{reference,2wl}", 0,
    "Use the specified clause watcher (default: reference)"},
   {"decay", 6, "DOUBLE", 0,
    "Variable activity decay factor (default: 0.96875)"},
+  {"reduce-first", 17, "N", 0,
+   "Conflicts before the first reduction with --forget=reduce "
+   "(default: 2000)"},
   {"bump", 7, "{learnt,conflict}", 0,
    "Use the specified bump plugin (default: conflict)"},
   {"clause-decay", 8, "DOUBLE", 0,
@@ -42,12 +48,40 @@ static argp_option options[] = {
   {"minimize", 'm', "BOOL", 0,
    "Try to subsume the learnt clause by resolving it with some other "
    "clause in the database (default: 0)"},
+  {"otfs", 11, "BOOL", 0,
+   "During conflict analysis, replace a reason or conflict clause by a "
+   "resolvent that subsumes it (default: 0)"},
   {"phase", 's', "{save,0,1}", 0,
    "When deciding a variable, set it to the specified polarity. (default:save)"},
+  {"verify", 9, "{off,sampled,full}", 0,
+   "How often invariants are checked in debug builds (default: full)"},
+  {"verify-rate", 10, "DOUBLE", 0,
+   "Fraction of conflicts that are checked with --verify=sampled "
+   "(default: 0.01)"},
   {"proof-dag", 'p', "FILE", 0,
-   "Output the proof dag to FILE (default: null)"},
+   "Output the proof dag to FILE, in the format given by its extension: "
+   ".dot, .tex, .beamer.tex, .asy, .rup (DRAT), .drat (binary DRAT) or "
+   ".lrat, followed by .gz to compress it "
+   "(default: null)"},
+  {"proof-stats", 12, "BOOL", 0,
+   "Keep the whole proof in memory and report its size. Implied by "
+   "--proof-dag (default: 0)"},
+  {"trim", 15, "BOOL", 0,
+   "Drop the lemmas that the empty clause does not depend on before "
+   "drawing or measuring the proof (default: 0)"},
+  {"core", 16, "FILE", 0,
+   "Write the formula clauses that the proof uses, an unsatisfiable core, "
+   "to FILE in DIMACS (default: null)"},
+  {"binary-cnf", 13, "FILE", 0,
+   "Write the formula to FILE in a binary format that --in loads "
+   "without parsing (default: null)"},
+  {"check", 14, "FILE", 0,
+   "Instead of solving, check the proof of unsatisfiability in FILE, in the "
+   "format given by its extension: .rup (DRAT), .drat (binary DRAT) or .lrat. "
+   "Lemmas may be RUP or RAT on their first literal (default: null)"},
   {"trace", 't', "FILE", 0,
-   "Output the decision sequence to FILE (default: null)"},
+   "Output the decision sequence to FILE, compressed if it ends in .gz "
+   "(default: null)"},
   {"pebbling-graph", 1, "FILE", 0,
    "Hint that the formula is the pebbbling of FILE (default: null)"},
   {"substitution-fn", 2, "{xor}", 0,
@@ -75,10 +109,19 @@ struct arguments {
   double decay;
   string bump;
   double clause_decay;
+  unsigned reduce_first;
   bool backjump;
   bool minimize;
+  bool otfs;
   string phase;
+  string verify;
+  double verify_rate;
   string dag;
+  bool proof_stats;
+  bool trim;
+  string core;
+  string binary_cnf;
+  string check;
   string trace;
   string pebbling_graph;
   string substitution_fn;
@@ -115,6 +158,9 @@ static error_t parse_opt (int key, char *arg, argp_state *state) {
   case 'm':
     arguments->minimize = atoi(arg);
     break;
+  case 11:
+    arguments->otfs = atoi(arg);
+    break;
   case 's':
     arguments->phase = arg;
     break;
@@ -148,6 +194,31 @@ static error_t parse_opt (int key, char *arg, argp_state *state) {
   case 8:
     arguments->clause_decay = atof(arg);
     break;
+  case 9:
+    arguments->verify = arg;
+    break;
+  case 10:
+    arguments->verify_rate = atof(arg);
+    break;
+  case 12:
+    arguments->proof_stats = atoi(arg);
+    break;
+  case 13:
+    arguments->binary_cnf = arg;
+    break;
+  case 14:
+    arguments->check = arg;
+    break;
+  case 15:
+    arguments->trim = atoi(arg);
+    break;
+  case 16:
+    arguments->core = arg;
+    break;
+  case 17:
+    if (atoi(arg) < 1) argp_error(state, "--reduce-first must be at least 1");
+    arguments->reduce_first = atoi(arg);
+    break;
   case 'v':
     arguments->verbose = atoi(arg);
     break;
@@ -163,6 +234,12 @@ bool endswith(string s, string t) {
   return mismatch(t.rbegin(), t.rend(), s.rbegin()).first == t.rend();
 }
 
+// Outputs are written by a background thread, and compressed if
+// their name ends in .gz.
+shared_ptr<ostream> open_output(const string& path) {
+  return make_shared<async_ostream>(path, endswith(path, ".gz"));
+}
+
 void backtrace_handler(int);
 
 int main(int argc, char** argv) {
@@ -177,10 +254,16 @@ int main(int argc, char** argv) {
   arguments.decay = 1.-1./32.;
   arguments.bump = "conflict";
   arguments.clause_decay = 1.-1./2048.;
+  arguments.reduce_first = 2000;
   arguments.backjump = true;
   arguments.minimize = false;
+  arguments.otfs = false;
   arguments.phase = "save";
+  arguments.verify = "full";
+  arguments.verify_rate = 0.01;
   arguments.dag = "";
+  arguments.proof_stats = false;
+  arguments.trim = false;
   arguments.pebbling_graph = "";
   arguments.substitution_fn = "xor";
   arguments.substitution_arity = 2;
@@ -193,13 +276,21 @@ int main(int argc, char** argv) {
   cnf f;
   if (arguments.in != string("-")) {
     LOG(LOG_ACTIONS) << "Parsing from " << arguments.in << endl;
-    ifstream in(arguments.in);
-    f = parse_dimacs(in);
+    f = parse_dimacs_file(arguments.in);
   }
   else {
     LOG(LOG_ACTIONS) << "Parsing from stdin" << endl;
     f = parse_dimacs(cin);
   }
+  if (not arguments.binary_cnf.empty()) {
+    ofstream out(arguments.binary_cnf, ios::binary);
+    write_binary_cnf(out, f);
+  }
+  if (not arguments.check.empty()) {
+    bool verified = check_proof(f, arguments.check);
+    LOG(LOG_RESULTS) << (verified ? "VERIFIED" : "NOT VERIFIED") << endl;
+    return verified ? 0 : 1;
+  }
 
   cdcl_solver solver;
   solver.decide = arguments.decide;
@@ -210,12 +301,36 @@ int main(int argc, char** argv) {
   solver.bump = arguments.bump;
   solver.decay = arguments.decay;
   solver.clause_decay = arguments.clause_decay;
+  solver.reduce_first = arguments.reduce_first;
   solver.backjump = arguments.backjump;
   solver.minimize = arguments.minimize;
+  solver.otfs = arguments.otfs;
+  string format = arguments.dag;
+  if (endswith(format, ".gz")) format.resize(format.size()-3);
+  // Only graphical proofs show the trail of each conflict.
+  solver.record_trails = endswith(format, ".dot") or
+    endswith(format, ".tex") or endswith(format, ".asy");
+  // DRAT proofs are written while solving. Without another proof to
+  // write, forgotten lemmas can be freed.
+  bool streamed = endswith(format, ".rup") or endswith(format, ".drat") or
+    endswith(format, ".lrat");
+  solver.keep_proof = arguments.proof_stats or not arguments.core.empty() or
+    (not arguments.dag.empty() and not streamed);
   solver.phase = arguments.phase;
+  solver.verify = arguments.verify;
+  solver.verify_rate = arguments.verify_rate;
 
+  if (endswith(format, ".rup")) {
+    solver.proof_stream.reset(new drat_writer(open_output(arguments.dag)));
+  }
+  else if (endswith(format, ".drat")) {
+    solver.proof_stream.reset(new binary_drat_writer(open_output(arguments.dag)));
+  }
+  else if (endswith(format, ".lrat")) {
+    solver.proof_stream.reset(new lrat_writer(open_output(arguments.dag)));
+  }
   if (not arguments.trace.empty()) {
-    solver.trace = shared_ptr<ostream>(new ofstream(arguments.trace));
+    solver.trace = open_output(arguments.trace);
     *solver.trace << "# -*- mode: conf -*-" << endl;
     *solver.trace << "batch 1" << endl;
   }
@@ -233,20 +348,33 @@ int main(int argc, char** argv) {
   }
 #endif
 
+  int variables = f.variables;
+  unordered_map<int, string> variable_names;
+  if (not arguments.core.empty()) variable_names = f.variable_names;
+
   LOG(LOG_ACTIONS) << "Start solving" << endl;
-  proof proof = solver.solve(f);
-
-  if (not arguments.dag.empty()) {
-    ofstream dag(arguments.dag);
-    if (endswith(arguments.dag, ".dot")) draw(dag, proof);
-    else if (endswith(arguments.dag, ".beamer.tex")) tikz(dag, proof, true);
-    else if (endswith(arguments.dag, ".tex")) tikz(dag, proof);
-    else if (endswith(arguments.dag, ".asy")) asy(dag, proof);
-    else if (endswith(arguments.dag, ".rup")) rup(dag, proof);
+  result result = solver.solve(std::move(f));
+  if (result.sat) return 0;
+  proof& proof = result.proof;
+
+  if (not arguments.core.empty()) {
+    cnf core = unsat_core(proof);
+    core.variables = variables;
+    core.variable_names = std::move(variable_names);
+    write_dimacs(*open_output(arguments.core), core);
+  }
+  if (arguments.trim) trim(proof);
+
+  if (not arguments.dag.empty() and not streamed) {
+    shared_ptr<ostream> dag = open_output(arguments.dag);
+    if (endswith(format, ".dot")) draw(*dag, proof);
+    else if (endswith(format, ".beamer.tex")) tikz(*dag, proof, true);
+    else if (endswith(format, ".tex")) tikz(*dag, proof);
+    else if (endswith(format, ".asy")) asy(*dag, proof);
     else {
       cerr << "Unknown output format" << endl;
       exit(1);
     }
   }
-  measure(proof);
+  if (solver.keep_proof) measure(proof);
 }
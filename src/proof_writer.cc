@@ -0,0 +1,84 @@
+#include "proof_writer.h"
+
+using namespace std;
+
+void drat_writer::write(const clause& c) {
+  for (literal l : c) {
+    if (not l.polarity()) *out << '-';
+    *out << variable(l)+1 << ' ';
+  }
+  *out << "0\n";
+}
+
+void drat_writer::add(const proof_clause& c) {
+  write(c.c);
+}
+
+void drat_writer::remove(const proof_clause& c) {
+  *out << "d ";
+  write(c.c);
+}
+
+void lrat_writer::start(const vector<proof_clause>& formula) {
+  flush_deleted();
+  axioms = formula.size();
+  last = axioms;
+  numbers.assign(axioms, 0);
+}
+
+void lrat_writer::add(const proof_clause& c) {
+  flush_deleted();
+  if (c.id >= numbers.size()) numbers.resize(c.id+1);
+  numbers[c.id] = ++last;
+  *out << last << ' ';
+  for (literal l : c.c) {
+    if (not l.polarity()) *out << '-';
+    *out << variable(l)+1 << ' ';
+  }
+  *out << '0';
+  // The derivation resolves the conflict with reasons from the last
+  // propagated backwards, so under the negation of the lemma the
+  // reasons become unit in reverse order and the conflict comes last.
+  for (auto it = c.derivation.rbegin(); it != c.derivation.rend(); ++it) {
+    *out << ' ' << number(**it);
+  }
+  *out << " 0\n";
+}
+
+void lrat_writer::remove(const proof_clause& c) {
+  deleted.push_back(number(c));
+}
+
+void lrat_writer::flush_deleted() {
+  if (deleted.empty()) return;
+  *out << last << " d";
+  for (uint64_t n : deleted) *out << ' ' << n;
+  *out << " 0\n";
+  deleted.clear();
+}
+
+lrat_writer::~lrat_writer() {
+  flush_deleted();
+}
+
+void binary_drat_writer::write(char kind, const clause& c) {
+  buffer.clear();
+  buffer.push_back(kind);
+  for (literal l : c) {
+    // 2x for the literal x and 2x+1 for its negation, with 1-based
+    // variables, in 7-bit groups starting from the lowest.
+    uint64_t u = 2*(uint64_t(variable(l))+1) + not l.polarity();
+    for (; u >= 0x80; u >>= 7) buffer.push_back(char(0x80 | (u & 0x7f)));
+    buffer.push_back(char(u));
+  }
+  buffer.push_back(0);
+  out->write(buffer.data(), buffer.size());
+}
+
+void binary_drat_writer::add(const proof_clause& c) {
+  write('a', c.c);
+}
+
+void binary_drat_writer::remove(const proof_clause& c) {
+  write('d', c.c);
+}
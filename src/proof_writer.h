@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "data_structures.h"
+
+// Receives the proof while it is found, so that it can be written out
+// without keeping every lemma in memory.
+class proof_writer {
+ public:
+  virtual ~proof_writer() {}
+  // The solver starts on a formula whose clauses are numbered by
+  // their position.
+  virtual void start(const std::vector<proof_clause>& formula) {}
+  // A lemma joins the working clauses. Its derivation is still
+  // available.
+  virtual void add(const proof_clause& c) = 0;
+  // A clause leaves the working clauses for good.
+  virtual void remove(const proof_clause& c) = 0;
+};
+
+// DRAT in the textual DIMACS-like format.
+class drat_writer : public proof_writer {
+ public:
+  drat_writer(std::shared_ptr<std::ostream> from_out) : out(from_out) {}
+  virtual void add(const proof_clause& c);
+  virtual void remove(const proof_clause& c);
+ private:
+  std::shared_ptr<std::ostream> out;
+  void write(const clause& c);
+};
+
+// LRAT, with the derivation of each lemma as its hints. Formula
+// clauses are numbered from 1 in input order, and lemmas after them.
+class lrat_writer : public proof_writer {
+ public:
+  lrat_writer(std::shared_ptr<std::ostream> from_out) : out(from_out) {}
+  ~lrat_writer();
+  virtual void start(const std::vector<proof_clause>& formula);
+  virtual void add(const proof_clause& c);
+  virtual void remove(const proof_clause& c);
+ private:
+  std::shared_ptr<std::ostream> out;
+  size_t axioms = 0;
+  // Number of the last clause.
+  uint64_t last = 0;
+  // LRAT number of each lemma, indexed by clause id.
+  std::vector<uint64_t> numbers;
+  // Deletions are written together before the next lemma.
+  std::vector<uint64_t> deleted;
+  uint64_t number(const proof_clause& c) const {
+    return c.id < axioms ? c.id+1 : numbers[c.id];
+  }
+  void flush_deleted();
+};
+
+// DRAT in the binary format: an 'a' or 'd' byte, then each literal
+// as a variable-length integer, then a zero byte.
+class binary_drat_writer : public proof_writer {
+ public:
+  binary_drat_writer(std::shared_ptr<std::ostream> from_out) : out(from_out) {}
+  virtual void add(const proof_clause& c);
+  virtual void remove(const proof_clause& c);
+ private:
+  std::shared_ptr<std::ostream> out;
+  // Bytes of the line being written, reused across lines.
+  std::vector<char> buffer;
+  void write(char kind, const clause& c);
+};
@@ -1,29 +1,62 @@
 #pragma once
 
-#include <deque>
+#include <vector>
 
 #include "clause_database.h"
 
+// FIFO of branches waiting to be unit-propagated, stored in a ring
+// buffer whose capacity is a power of two. The same literal may be
+// queued several times with different reasons.
 struct propagation_queue {
-  std::deque<branch> q;
+  std::vector<branch> q;
+  // Positions of the front and one past the back. They only grow, and
+  // are reduced modulo the capacity on access.
+  size_t head = 0, tail = 0;
+  propagation_queue() : q(64, unused) {}
   template<typename T>
   void propagate(const T& c) {
     assert(c.unit());
-    q.push_back(c.propagate());
+    push(c.propagate());
   }
   void decide(literal l) {
-    q.push_back({l,NULL});
+    push({l,NULL});
   }
   void clear() {
-    q.clear();
+    head = tail = 0;
   }
   void pop() {
-    q.pop_front();
+    assert(not empty());
+    ++head;
   }
   bool empty() const {
-    return q.empty();
+    return head == tail;
+  }
+  size_t size() const {
+    return tail - head;
   }
   const branch& front() const {
-    return q.front();
+    return q[head & (q.size()-1)];
+  }
+  const branch& operator [] (size_t i) const {
+    return q[(head+i) & (q.size()-1)];
+  }
+  // Make room for at least n branches without growing.
+  void reserve(size_t n) {
+    size_t capacity = q.size();
+    while (capacity < n) capacity *= 2;
+    if (capacity != q.size()) resize(capacity);
+  }
+private:
+  static constexpr branch unused = {literal::from_raw(0), NULL};
+  void push(const branch& b) {
+    if (size() == q.size()) resize(2*q.size());
+    q[tail++ & (q.size()-1)] = b;
+  }
+  void resize(size_t capacity) {
+    std::vector<branch> r(capacity, unused);
+    for (size_t i=0; i<size(); ++i) r[i] = (*this)[i];
+    tail = size();
+    head = 0;
+    q.swap(r);
   }
 };
@@ -97,7 +97,8 @@ void lazy_restricted_clause::loosen(literal l) {
   }
 }
 
-void lazy_restricted_clause::restrict_to_unit(const std::vector<int>& assignment) {
+void lazy_restricted_clause::restrict_falsified(const std::vector<int>& assignment,
+                                                const std::vector<int>& decision_level) {
   for (auto it=source->begin();it!=source->end();++it) {
     int al = assignment[variable(*it)];
     if (al) {
@@ -19,10 +19,16 @@ struct eager_restricted_clause : clause_pointer {
   void restrict(literal l);
   void loosen(literal l);
   void restrict(const std::vector<int>& assignment);
+  void restrict_falsified(const std::vector<int>& assignment,
+                          const std::vector<int>& decision_level) {
+    restrict(assignment);
+    assert(not satisfied and not literals.empty());
+  }
   void restrict_to_unit(const std::vector<int>& assignment) {
     restrict(assignment);
   }
   void reset();
+  size_t memory() const { return literals.capacity()*sizeof(literal); }
 };
 std::ostream& operator << (std::ostream& o, const eager_restricted_clause& c);
 
@@ -46,8 +52,15 @@ struct lazy_restricted_clause : clause_pointer {
 
   void restrict(literal l);
   void loosen(literal l);
-  void restrict_to_unit(const std::vector<int>& assignment);
+  void restrict_falsified(const std::vector<int>& assignment,
+                          const std::vector<int>& decision_level);
+  void restrict_to_unit(const std::vector<int>& assignment) {
+    restrict_falsified(assignment, {});
+  }
   void reset();
+  size_t memory() const {
+    return literals.num_blocks()*sizeof(boost::dynamic_bitset<>::block_type);
+  }
 };
 std::ostream& operator << (std::ostream& o, const lazy_restricted_clause& c);
 
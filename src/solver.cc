@@ -26,13 +26,17 @@ cdcl solver_factory(const string& watcher) {
   }
 }
 
-proof cdcl_solver::solve(const cnf& f) {
+result cdcl_solver::solve(cnf&& f) {
   if (decide == "ask" and watcher == "2wl") {
     cerr << "Warning: 2wl in interactive mode. Printing the state will crash." << endl;
   }
   pretty = pretty_(f);
   pretty.mode = pretty.TERMINAL;
-  cdcl solver(solver_factory(watcher));
+  if (not instance or instance_watcher != watcher) {
+    instance.reset(new cdcl(solver_factory(watcher)));
+    instance_watcher = watcher;
+  }
+  cdcl& solver = *instance;
   class ui ui (solver);
   if (decide == "ask") {
     solver.decide_plugin = bind(&ui::get_decision, ref(ui));
@@ -74,6 +78,7 @@ proof cdcl_solver::solve(const cnf& f) {
   if (forget == "nothing") solver.forget_plugin = &cdcl::forget_nothing;
   else if (forget == "everything") solver.forget_plugin = &cdcl::forget_everything;
   else if (forget == "wide") solver.forget_plugin = static_cast<void (cdcl::*)(void)>(&cdcl::forget_wide);
+  else if (forget == "reduce") solver.forget_plugin = &cdcl::forget_reduce;
   else {
     cerr << "Invalid forgetting scheme" << endl;
     exit(1);
@@ -96,6 +101,9 @@ proof cdcl_solver::solve(const cnf& f) {
   }
   solver.config_backjump = backjump;
   solver.config_minimize = minimize;
+  solver.config_otfs = otfs;
+  solver.config_record_trails = record_trails;
+  solver.config_keep_proof = keep_proof;
   if (phase == "save") {
     solver.config_default_polarity = false;
     solver.config_phase_saving = true;
@@ -106,6 +114,16 @@ proof cdcl_solver::solve(const cnf& f) {
   }
   solver.config_activity_decay = decay;
   solver.config_clause_decay = clause_decay;
+  solver.config_reduce_first = reduce_first;
+  if (verify == "off") solver.config_verify = cdcl::VERIFY_OFF;
+  else if (verify == "sampled") solver.config_verify = cdcl::VERIFY_SAMPLED;
+  else if (verify == "full") solver.config_verify = cdcl::VERIFY_FULL;
+  else {
+    cerr << "Invalid verification level" << endl;
+    exit(1);
+  }
+  solver.config_verify_rate = verify_rate;
   solver.trace = trace;
-  return solver.solve(f);
+  solver.proof_stream = proof_stream;
+  return solver.solve(std::move(f));
 }
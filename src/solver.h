@@ -5,14 +5,25 @@
 #include <memory>
 
 #include "data_structures.h"
+#include "proof_writer.h"
 #include "viz.h"
 
+class cdcl;
+
 struct cdcl_solver {
  public:
-  proof solve(const cnf& f);
-  std::string decide, restart, learn, forget, bump, watcher, phase;
+  // Configures a solver from the options below and runs it on f. The
+  // solver is kept and reused by later calls with the same watcher.
+  result solve(cnf&& f);
+  std::string decide, restart, learn, forget, bump, watcher, phase, verify;
   double decay, clause_decay;
-  bool backjump, minimize;
+  unsigned reduce_first = 2000;
+  double verify_rate = 0.01;
+  bool backjump, minimize, otfs, record_trails, keep_proof;
   std::shared_ptr<std::ostream> trace;
+  std::shared_ptr<proof_writer> proof_stream;
   std::shared_ptr<graphviz_viz> vz;
+ private:
+  std::shared_ptr<cdcl> instance;
+  std::string instance_watcher;
 };
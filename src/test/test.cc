@@ -1,11 +1,23 @@
 #include "../data_structures.h"
 #include "../solver.h"
 #include "../dimacs.h"
+#include "../checker.h"
+#include "../analysis.h"
+#include "../async_stream.h"
+#include "../arena.h"
+#include "../propagation_queue.h"
 
 #include <gtest/gtest.h>
 
+#include <fstream>
+#include <random>
+#include <set>
 #include <tuple>
 
+#include <unistd.h>
+#include <lzma.h>
+#include <zlib.h>
+
 using namespace std;
 using testing::Test;
 using testing::TestWithParam;
@@ -15,6 +27,49 @@ using testing::Bool;
 
 literal from_dimacs (int x) { return literal::from_dimacs(x); }
 
+TEST(ArenaTest, reset_keeps_chunks) {
+  arena<vector<int>, 16> a;
+  for (int i=0; i<100; ++i) a.emplace_back(i, i);
+  size_t memory = a.memory();
+  a.reset();
+  EXPECT_TRUE(a.empty());
+  EXPECT_EQ(a.memory(), memory);
+  for (int i=0; i<100; ++i) a.emplace(1, i);
+  EXPECT_EQ(a.memory(), memory);
+  EXPECT_EQ(a[99], vector<int>({99}));
+  a.release();
+  EXPECT_TRUE(a.empty());
+  EXPECT_LT(a.memory(), memory);
+}
+
+TEST(PropagationQueueTest, wrap_and_grow) {
+  propagation_queue queue;
+  size_t capacity = queue.q.size();
+  unsigned pushed = 0, popped = 0;
+  auto push = [&queue, &pushed](unsigned n) {
+    for (unsigned i=0; i<n; ++i) queue.decide(literal::from_raw(pushed++));
+  };
+  auto check = [&queue, &popped, &pushed]() {
+    ASSERT_EQ(queue.size(), pushed-popped);
+    for (size_t i=0; i<queue.size(); ++i) EXPECT_EQ(queue[i].to.l, popped+i);
+  };
+  push(capacity*3/4);
+  for (; popped<capacity/2; ++popped) queue.pop();
+  // Past the end of the buffer, from a head in the middle.
+  push(capacity*3/4);
+  EXPECT_EQ(queue.q.size(), capacity);
+  check();
+  // Grow while the contents wrap around.
+  push(capacity/2);
+  EXPECT_GT(queue.q.size(), capacity);
+  check();
+  for (; popped<pushed; ++popped) {
+    EXPECT_EQ(queue.front().to.l, popped);
+    queue.pop();
+  }
+  EXPECT_TRUE(queue.empty());
+}
+
 TEST(ClauseTest, subsumes) {
   clause c;
   clause d(vector<literal>({from_dimacs(1)}));
@@ -22,6 +77,16 @@ TEST(ClauseTest, subsumes) {
   EXPECT_FALSE(d.subsumes(c));
 }
 
+TEST(ClauseTest, subsumes_signature_collision) {
+  clause c = clause::from_dimacs({33, -2});
+  clause d = clause::from_dimacs({1, -2, 5});
+  EXPECT_EQ(c.literal_signature() & ~d.literal_signature(), 0);
+  EXPECT_FALSE(c.subsumes(d));
+  EXPECT_TRUE(c.subsumes(d, from_dimacs(33)));
+  EXPECT_FALSE(c.subsumes(d, from_dimacs(-2)));
+  EXPECT_EQ(d.domain_signature() & clause::variable_bits(32), clause::variable_bits(32));
+}
+
 TEST(ClauseTest, resolve_empty) {
   clause c(vector<literal>({from_dimacs(1)}));
   clause d(vector<literal>({from_dimacs(-1)}));
@@ -54,6 +119,104 @@ TEST(ClauseTest, resolve_fail_self) {
   EXPECT_DEATH(resolve(c,d),"");
 }
 
+TEST(ParserTest, clauses) {
+  istringstream s("c varname 2 x\np cnf 3 3\n\n3 -1 3 0\nc comment\n  2\t-3 0 junk\r\n0\n");
+  cnf f = parse_dimacs(s);
+  EXPECT_EQ(f.variables, 3);
+  EXPECT_EQ(f.variable_names.at(1), "x");
+  ASSERT_EQ(f.clauses.size(), 3);
+  EXPECT_TRUE(f.clauses[0] == clause::from_dimacs({-1, 3}));
+  EXPECT_TRUE(f.clauses[1] == clause::from_dimacs({2, -3}));
+  EXPECT_EQ(f.clauses[2].width(), 0);
+}
+
+TEST(ParserTest, unterminated) {
+  istringstream s("p cnf 2 1\n1 2\n");
+  EXPECT_DEATH(parse_dimacs(s), "not zero-terminated");
+}
+
+TEST(ParserTest, threads) {
+  string s = "c varname 1 a\np cnf 5 6\n1 2 0\n-3 4 0\nc comment\n5 0\n\n-1 -5 0\n2 3 4 0\n0\n";
+  cnf sequential = parse_dimacs(s.data(), s.data()+s.size(), 1);
+  for (unsigned threads : {2, 3, 8}) {
+    cnf parallel = parse_dimacs(s.data(), s.data()+s.size(), threads);
+    EXPECT_EQ(parallel.variables, sequential.variables);
+    EXPECT_EQ(parallel.variable_names, sequential.variable_names);
+    ASSERT_EQ(parallel.clauses.size(), sequential.clauses.size());
+    for (size_t i=0; i<sequential.clauses.size(); ++i) {
+      EXPECT_TRUE(parallel.clauses[i] == sequential.clauses[i]);
+    }
+  }
+}
+
+TEST(ParserTest, gzip) {
+  char path[] = "/tmp/sat-test-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  gzFile out = gzdopen(fd, "wb");
+  gzputs(out, "p cnf 2 2\n1 -2 0\n2 0\n");
+  gzclose(out);
+  cnf f = parse_dimacs_file(path);
+  unlink(path);
+  ASSERT_EQ(f.clauses.size(), 2);
+  EXPECT_TRUE(f.clauses[0] == clause::from_dimacs({1, -2}));
+  EXPECT_TRUE(f.clauses[1] == clause::from_dimacs({2}));
+}
+
+TEST(ParserTest, xz) {
+  char path[] = "/tmp/sat-test-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  string text = "p cnf 2 2\n1 -2 0\n2 0\n";
+  vector<uint8_t> compressed(1024);
+  size_t size = 0;
+  ASSERT_EQ(lzma_easy_buffer_encode(6, LZMA_CHECK_CRC64, NULL,
+                                    reinterpret_cast<const uint8_t*>(text.data()), text.size(),
+                                    compressed.data(), &size, compressed.size()),
+            LZMA_OK);
+  ASSERT_EQ(write(fd, compressed.data(), size), ssize_t(size));
+  close(fd);
+  cnf f = parse_dimacs_file(path);
+  unlink(path);
+  ASSERT_EQ(f.clauses.size(), 2);
+  EXPECT_TRUE(f.clauses[0] == clause::from_dimacs({1, -2}));
+  EXPECT_TRUE(f.clauses[1] == clause::from_dimacs({2}));
+}
+
+TEST(ParserTest, write_dimacs) {
+  istringstream s("c varname 2 x\np cnf 3 3\n1 -2 0\n0\n-3 2 1 0\n");
+  cnf f = parse_dimacs(s);
+  ostringstream out;
+  write_dimacs(out, f);
+  istringstream in(out.str());
+  cnf g = parse_dimacs(in);
+  EXPECT_EQ(g.variables, f.variables);
+  EXPECT_EQ(g.variable_names, f.variable_names);
+  ASSERT_EQ(g.clauses.size(), f.clauses.size());
+  for (size_t i=0; i<f.clauses.size(); ++i) EXPECT_TRUE(g.clauses[i] == f.clauses[i]);
+}
+
+TEST(ParserTest, binary) {
+  istringstream s("c varname 2 x\np cnf 3 3\n1 -2 0\n0\n-3 2 1 0\n");
+  cnf f = parse_dimacs(s);
+  char path[] = "/tmp/sat-test-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  {
+    ofstream out(path, ios::binary);
+    write_binary_cnf(out, f);
+  }
+  cnf g = parse_dimacs_file(path);
+  unlink(path);
+  EXPECT_EQ(g.variables, f.variables);
+  EXPECT_EQ(g.variable_names, f.variable_names);
+  ASSERT_EQ(g.clauses.size(), f.clauses.size());
+  for (size_t i=0; i<f.clauses.size(); ++i) {
+    EXPECT_TRUE(g.clauses[i] == f.clauses[i]);
+  }
+}
+
 class SolverTest : public Test {
 protected:
   cdcl_solver solver;
@@ -66,35 +229,417 @@ protected:
     solver.bump = "learnt";
     solver.backjump = true;
     solver.minimize = false;
-    solver.phase_saving = false;
+    solver.otfs = false;
+    solver.record_trails = false;
+    solver.keep_proof = true;
+    solver.phase = "0";
+    solver.verify = "full";
+    solver.verify_rate = 0.01;
   }
 };
 
 TEST_F(SolverTest, empty) {
   istringstream s("p cnf 0 0\n");
   cnf f = parse_dimacs(s);
-  ASSERT_EXIT(solver.solve(f), ::testing::ExitedWithCode(0), "");
+  EXPECT_TRUE(solver.solve(std::move(f)).sat);
 }
 
 TEST_F(SolverTest, contradiction) {
   istringstream s("p cnf 0 1\n0\n");
   cnf f = parse_dimacs(s);
-  ASSERT_DEATH(solver.solve(f), "");
+  ASSERT_DEATH(solver.solve(std::move(f)), "");
 }
 
 TEST_F(SolverTest, sat) {
   istringstream s("p cnf 1 1\n1 0\n");
   cnf f = parse_dimacs(s);
-  ASSERT_EXIT(solver.solve(f), ::testing::ExitedWithCode(0), "");
+  result r = solver.solve(std::move(f));
+  EXPECT_TRUE(r.sat);
+  EXPECT_EQ(r.model, vector<int>({1}));
 }
 
 TEST_F(SolverTest, unit) {
   istringstream s("p cnf 1 2\n1 0\n-1 0\n");
   cnf f = parse_dimacs(s);
-  proof pi = solver.solve(f);
+  proof pi = solver.solve(std::move(f)).proof;
   EXPECT_EQ(pi.resolution.size(), 1);
 }
 
+// Pigeonhole principle with 4 pigeons and 3 holes
+const char* php43 =
+  "p cnf 12 22\n"
+  "1 2 3 0\n4 5 6 0\n7 8 9 0\n10 11 12 0\n"
+  "-1 -4 0\n-1 -7 0\n-1 -10 0\n-4 -7 0\n-4 -10 0\n-7 -10 0\n"
+  "-2 -5 0\n-2 -8 0\n-2 -11 0\n-5 -8 0\n-5 -11 0\n-8 -11 0\n"
+  "-3 -6 0\n-3 -9 0\n-3 -12 0\n-6 -9 0\n-6 -12 0\n-9 -12 0\n";
+
+// Random 3-CNF formula in dimacs format. The generator is seeded, so
+// the formula is the same on every run.
+string random_3cnf(int variables, int clauses, unsigned seed) {
+  mt19937 prg(seed);
+  ostringstream s;
+  s << "p cnf " << variables << ' ' << clauses << '\n';
+  for (int i=0; i<clauses; ++i) {
+    set<int> domain;
+    while (domain.size() < 3) domain.insert(prg()%variables + 1);
+    for (int x : domain) s << (prg()%2 ? x : -x) << ' ';
+    s << "0\n";
+  }
+  return s.str();
+}
+
+TEST_F(SolverTest, sampled_verification) {
+  solver.verify = "sampled";
+  solver.verify_rate = 0.5;
+  istringstream s(php43);
+  result r = solver.solve(parse_dimacs(s));
+  EXPECT_EQ(r.proof.resolution.back().c.width(), 0);
+#ifndef NDEBUG
+  // The sampling generator is seeded, so this is deterministic.
+  EXPECT_GT(r.stats.verified, 0);
+  EXPECT_LT(r.stats.verified, r.stats.conflicts + 1);
+#endif
+}
+
+TEST_F(SolverTest, forget_reduce) {
+  solver.forget = "reduce";
+  solver.reduce_first = 10;
+  auto out = make_shared<stringstream>();
+  solver.proof_stream = make_shared<drat_writer>(out);
+  string formula = random_3cnf(30, 150, 1);
+  istringstream s(formula);
+  result r = solver.solve(parse_dimacs(s));
+  solver.proof_stream.reset();
+  EXPECT_GT(r.stats.forgotten, 0);
+  ASSERT_FALSE(r.sat);
+  // The proof, with its deletions, still refutes the formula.
+  istringstream t(formula), proof(out->str());
+  EXPECT_TRUE(check_drat(parse_dimacs(t), proof, false));
+}
+
+TEST_F(SolverTest, reduce_first_short) {
+  solver.forget = "reduce";
+  string formula = random_3cnf(30, 150, 1);
+  vector<result> results;
+  // An interval of 0 is taken as 1.
+  for (unsigned first : {0, 1}) {
+    solver.reduce_first = first;
+    istringstream s(formula);
+    results.push_back(solver.solve(parse_dimacs(s)));
+  }
+  EXPECT_EQ(results[0].stats.reductions, results[1].stats.reductions);
+  EXPECT_EQ(results[0].stats.conflicts, results[1].stats.conflicts);
+  // The interval grows by at least one conflict each time, so k
+  // reductions take at least k(k+1)/2 conflicts.
+  int k = results[1].stats.reductions;
+  EXPECT_GT(k, 1);
+  EXPECT_LE(k*(k+1)/2, results[1].stats.conflicts);
+}
+
+TEST_F(SolverTest, forget_touches_keeps_formula) {
+  // Lemmas that take the place of a formula clause during on-the-fly
+  // strengthening must not be forgotten, or the model may violate the
+  // clause they replaced.
+  solver.decide = "ask";
+  solver.otfs = true;
+  const int variables = 30;
+  string forget = "forget touches any";
+  for (int x=1; x<=variables; ++x) forget += " " + to_string(x);
+  string script = "batch 1\n";
+  for (int i=0; i<1000; ++i) script += forget + "\n\n";
+  for (unsigned seed=111; seed<=130; ++seed) {
+    string formula = random_3cnf(variables, 120, seed);
+    istringstream s(formula), in(script);
+    streambuf* stdin_buf = cin.rdbuf(in.rdbuf());
+    result r = solver.solve(parse_dimacs(s));
+    cin.rdbuf(stdin_buf);
+    if (not r.sat) continue;
+    istringstream t(formula);
+    for (const clause& c : parse_dimacs(t).clauses) {
+      EXPECT_TRUE(any_of(c.begin(), c.end(), [&r] (literal l) {
+            return r.model[variable(l)] == (l.polarity() ? 1 : -1);
+          })) << "seed " << seed;
+    }
+  }
+}
+
+TEST_F(SolverTest, record_trails) {
+  for (bool record : {false, true}) {
+    solver.record_trails = record;
+    istringstream s(php43);
+    proof pi = solver.solve(parse_dimacs(s)).proof;
+    EXPECT_EQ(pi.trails.nodes.empty(), not record);
+    for (const proof_clause& c : pi.resolution) {
+      if (c.derivation.empty()) continue;
+      EXPECT_EQ(pi.trails.trail(c.trail).empty(), not record);
+    }
+  }
+}
+
+TEST_F(SolverTest, otfs) {
+  // php43 is refuted without any strengthening with these settings.
+  solver.otfs = true;
+  for (const char* watcher : {"reference", "2wl"}) {
+    solver.watcher = watcher;
+    istringstream s(random_3cnf(12, 60, 1));
+    result r = solver.solve(parse_dimacs(s));
+    ASSERT_FALSE(r.sat);
+    EXPECT_EQ(r.proof.resolution.back().c.width(), 0);
+    EXPECT_GT(r.stats.strengthened, 0) << watcher;
+  }
+}
+
+TEST_F(SolverTest, release_forgotten) {
+  solver.forget = "everything";
+  solver.otfs = true;
+  for (const char* watcher : {"reference", "2wl"}) {
+    solver.watcher = watcher;
+    istringstream s(php43);
+    solver.keep_proof = true;
+    proof kept = solver.solve(parse_dimacs(s)).proof;
+    s.clear();
+    s.seekg(0);
+    solver.keep_proof = false;
+    proof released = solver.solve(parse_dimacs(s)).proof;
+    EXPECT_LT(released.resolution.size(), kept.resolution.size());
+    EXPECT_TRUE(any_of(released.resolution.begin(), released.resolution.end(),
+                       [](const proof_clause& c) { return c.c.width() == 0; }));
+  }
+  // After many conflicts, the bookkeeping of a solver that forgets
+  // everything stays proportional to the clauses it is working with.
+  solver.verify = "off";
+  for (const char* watcher : {"reference", "2wl"}) {
+    solver.watcher = watcher;
+    istringstream s(random_3cnf(90, 400, 1));
+    result r = solver.solve(parse_dimacs(s));
+    EXPECT_FALSE(r.sat);
+    EXPECT_GT(r.stats.conflicts, 1000);
+    EXPECT_LT(r.memory.metadata, r.memory.formula + r.memory.working) << watcher;
+  }
+}
+
+TEST_F(SolverTest, reuse) {
+  solver.decide = "random";
+  solver.restart = "always";
+  for (const char* watcher : {"reference", "2wl"}) {
+    solver.watcher = watcher;
+    istringstream s(php43);
+    size_t lemmas = solver.solve(parse_dimacs(s)).proof.resolution.size();
+    istringstream t("p cnf 2 2\n1 2 0\n-1 0\n");
+    result r = solver.solve(parse_dimacs(t));
+    EXPECT_TRUE(r.sat);
+    EXPECT_EQ(r.model, vector<int>({-1, 1}));
+    s.clear();
+    s.seekg(0);
+    EXPECT_EQ(solver.solve(parse_dimacs(s)).proof.resolution.size(), lemmas);
+  }
+}
+
+// Keeps the working lemmas as reported to a proof writer.
+struct recording_writer : proof_writer {
+  multiset<vector<int>> live;
+  size_t added = 0, removed = 0;
+  bool refuted = false;
+  static vector<int> key(const proof_clause& c) {
+    vector<int> ret;
+    for (literal l : c.c) ret.push_back(l.l);
+    return ret;
+  }
+  virtual void add(const proof_clause& c) {
+    live.insert(key(c));
+    ++added;
+    refuted |= (c.c.width() == 0);
+  }
+  virtual void remove(const proof_clause& c) {
+    auto it = live.find(key(c));
+    if (it != live.end()) live.erase(it);
+    ++removed;
+  }
+};
+
+TEST_F(SolverTest, proof_stream) {
+  solver.forget = "everything";
+  solver.otfs = true;
+  solver.keep_proof = false;
+  for (const char* watcher : {"reference", "2wl"}) {
+    solver.watcher = watcher;
+    auto writer = make_shared<recording_writer>();
+    solver.proof_stream = writer;
+    istringstream s(php43);
+    solver.solve(parse_dimacs(s));
+    EXPECT_TRUE(writer->refuted);
+    EXPECT_GT(writer->removed, 0);
+    EXPECT_LT(writer->live.size(), writer->added);
+  }
+}
+
+TEST(ProofWriterTest, binary_drat) {
+  auto out = make_shared<ostringstream>();
+  binary_drat_writer writer(out);
+  proof_clause c(clause::from_dimacs({-1, 64}));
+  writer.add(c);
+  writer.remove(c);
+  EXPECT_EQ(out->str(), string("a\x03\x80\x01\x00" "d\x03\x80\x01\x00", 10));
+}
+
+TEST_F(SolverTest, trim) {
+  solver.learn = "lastuip";
+  solver.phase = "1";
+  istringstream s(php43);
+  result r = solver.solve(parse_dimacs(s));
+  proof& p = r.proof;
+  size_t before = p.resolution.size();
+  trim(p);
+  EXPECT_LT(p.resolution.size(), before);
+  size_t id = p.formula.size();
+  set<const proof_clause*> present;
+  for (const proof_clause& c : p.resolution) {
+    EXPECT_EQ(c.id, id++);
+    for (auto d : c.derivation) EXPECT_TRUE(d->id < p.formula.size() or present.count(d));
+    present.insert(&c);
+  }
+  EXPECT_EQ(p.resolution.back().c.width(), 0);
+  EXPECT_EQ(unsat_core(p).clauses.size(), 22);
+}
+
+TEST_F(SolverTest, unsat_core) {
+  istringstream s("p cnf 3 5\n3 1 0\n1 0\n-3 2 0\n-1 2 0\n-2 0\n");
+  result r = solver.solve(parse_dimacs(s));
+  cnf core = unsat_core(r.proof);
+  ASSERT_EQ(core.clauses.size(), 3);
+  EXPECT_TRUE(core.clauses[0] == clause::from_dimacs({1}));
+  EXPECT_TRUE(core.clauses[1] == clause::from_dimacs({-1, 2}));
+  EXPECT_TRUE(core.clauses[2] == clause::from_dimacs({-2}));
+}
+
+TEST(AsyncStreamTest, roundtrip) {
+  char path[] = "/tmp/sat-test-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  // Enough to go around the ring of chunks several times.
+  ostringstream expected;
+  for (int i=0; i<400000; ++i) expected << i << ' ' << -i << '\n';
+  for (bool compress : {false, true}) {
+    {
+      async_ostream out(path, compress);
+      for (int i=0; i<400000; ++i) out << i << ' ' << -i << '\n';
+    }
+    ifstream raw(path, ios::binary);
+    EXPECT_EQ(raw.get() == 0x1f and raw.get() == 0x8b, compress);
+    // gzread also reads uncompressed files.
+    gzFile in = gzopen(path, "rb");
+    ASSERT_TRUE(in);
+    string read;
+    char buffer[1<<16];
+    for (int n; (n = gzread(in, buffer, sizeof buffer)) > 0;) read.append(buffer, n);
+    gzclose(in);
+    EXPECT_EQ(read, expected.str());
+  }
+  unlink(path);
+}
+
+TEST(AsyncStreamTest, flush) {
+  char path[] = "/tmp/sat-test-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  for (bool compress : {false, true}) {
+    async_ostream out(path, compress);
+    out << "batch 1" << endl;
+    // Everything flushed is in the file while the stream is open.
+    gzFile in = gzopen(path, "rb");
+    ASSERT_TRUE(in);
+    char buffer[64];
+    int n = gzread(in, buffer, sizeof buffer);
+    gzclose(in);
+    EXPECT_EQ(string(buffer, max(n, 0)), "batch 1\n");
+  }
+  unlink(path);
+}
+
+TEST_F(SolverTest, lrat) {
+  auto out = make_shared<ostringstream>();
+  solver.proof_stream = make_shared<lrat_writer>(out);
+  istringstream s(php43);
+  solver.solve(parse_dimacs(s));
+  solver.proof_stream.reset();
+  // The last lemma is the empty clause, numbered after the 22 axioms.
+  string last;
+  istringstream lines(out->str());
+  for (string line; getline(lines, line);) {
+    if (line.find(" d ") == string::npos) last = line;
+  }
+  istringstream words(last);
+  int number, zero;
+  words >> number >> zero;
+  EXPECT_GT(number, 22);
+  EXPECT_EQ(zero, 0);
+}
+
+TEST_F(SolverTest, check) {
+  solver.forget = "everything";
+  solver.otfs = true;
+  for (const char* format : {"rup", "drat", "lrat"}) {
+    auto out = make_shared<stringstream>();
+    if (format == string("rup")) solver.proof_stream = make_shared<drat_writer>(out);
+    if (format == string("drat")) solver.proof_stream = make_shared<binary_drat_writer>(out);
+    if (format == string("lrat")) solver.proof_stream = make_shared<lrat_writer>(out);
+    istringstream s(php43);
+    solver.solve(parse_dimacs(s));
+    solver.proof_stream.reset();
+    s.clear();
+    s.seekg(0);
+    cnf f = parse_dimacs(s);
+    for (unsigned threads : {1, 3}) {
+      istringstream proof(out->str());
+      if (format == string("lrat")) EXPECT_TRUE(check_lrat(f, proof, threads));
+      else EXPECT_TRUE(check_drat(f, proof, format == string("drat"), threads));
+    }
+  }
+}
+
+// Every clause over three variables. The unit 1 is RAT on 1, but not
+// RUP.
+const char* full3 =
+  "p cnf 3 8\n"
+  "1 2 3 0\n1 2 -3 0\n1 -2 3 0\n1 -2 -3 0\n"
+  "-1 2 3 0\n-1 2 -3 0\n-1 -2 3 0\n-1 -2 -3 0\n";
+
+TEST(CheckerTest, rat) {
+  istringstream s(full3);
+  cnf f = parse_dimacs(s);
+  for (unsigned threads : {1, 3}) {
+    istringstream drat("1 0\n2 0\n0\n");
+    EXPECT_TRUE(check_drat(f, drat, false, threads));
+    istringstream lrat("9 1 0 -5 1 -6 2 -7 3 -8 4 0\n10 2 0 9 5 6 0\n11 0 9 10 7 8 0\n");
+    EXPECT_TRUE(check_lrat(f, lrat, threads));
+    // Clause 8 contains -1 too.
+    istringstream missing("9 1 0 -5 1 -6 2 -7 3 0\n10 2 0 9 5 6 0\n11 0 9 10 7 8 0\n");
+    EXPECT_FALSE(check_lrat(f, missing, threads));
+    istringstream wrong("9 1 0 -5 1 -6 2 -7 3 -8 3 0\n10 2 0 9 5 6 0\n11 0 9 10 7 8 0\n");
+    EXPECT_FALSE(check_lrat(f, wrong, threads));
+  }
+  // Without clause 1, the unit 1 is not RAT.
+  istringstream t("p cnf 3 7\n"
+                  "1 2 -3 0\n1 -2 3 0\n1 -2 -3 0\n"
+                  "-1 2 3 0\n-1 2 -3 0\n-1 -2 3 0\n-1 -2 -3 0\n");
+  cnf g = parse_dimacs(t);
+  istringstream drat("1 0\n2 0\n0\n");
+  EXPECT_FALSE(check_drat(g, drat, false));
+}
+
+TEST(CheckerTest, rejects) {
+  istringstream s(php43);
+  cnf f = parse_dimacs(s);
+  istringstream drat("1 0\n0\n");
+  EXPECT_FALSE(check_drat(f, drat, false));
+  // Clause 1 is not unit under the negation of the lemma.
+  istringstream lrat("23 0 1 0\n");
+  EXPECT_FALSE(check_lrat(f, lrat));
+  istringstream missing("23 0 24 0\n");
+  EXPECT_FALSE(check_lrat(f, missing));
+}
 
 typedef tuple<const char*, // decide
               const char*, // restart
@@ -104,7 +649,7 @@ typedef tuple<const char*, // decide
               const char*, // bump
               bool,        // backjump
               bool,        // minimize
-              bool>       // phase_saving
+              const char*> // phase
 SolverParams;
 
 class SolverCoverageTest : public TestWithParam<SolverParams> {
@@ -119,16 +664,25 @@ protected:
              solver.bump,
              solver.backjump,
              solver.minimize,
-             solver.phase_saving)
+             solver.phase)
       = GetParam();
+    solver.otfs = false;
+    solver.record_trails = true;
+    solver.keep_proof = true;
+    solver.verify = "full";
+    // The formulas here have very few conflicts.
+    solver.reduce_first = 1;
   }
 };
 
 TEST_P(SolverCoverageTest, CT2) {
   istringstream s("p cnf 2 4\n1 2 0\n1 -2 0\n-1 2 0\n-1 -2 0\n");
   cnf f = parse_dimacs(s);
-  proof pi = solver.solve(f);
+  proof pi = solver.solve(std::move(f)).proof;
   EXPECT_EQ(pi.resolution.size(), 2);
+  for (const proof_clause& c : pi.resolution) {
+    EXPECT_FALSE(pi.trails.trail(c.trail).empty());
+  }
 }
 
 INSTANTIATE_TEST_CASE_P(ParametersTest,
@@ -136,12 +690,12 @@ INSTANTIATE_TEST_CASE_P(ParametersTest,
                         Combine(Values("fixed"),
                                 Values("none","always","luby"),
                                 Values("1uip","1uip-all","lastuip","decision"),
-                                Values("nothing","everything","wide"),
+                                Values("nothing","everything","wide","reduce"),
                                 Values("reference","2wl"),
                                 Values("learnt","conflict"),
                                 Values(true),
                                 Bool(),
-                                Bool()));
+                                Values("save","0")));
 
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
@@ -56,6 +56,9 @@ void ui::show_state() {
   cout << "Learned clauses:" << endl << solver.learnt_clauses << endl;
   cout << "Restricted clauses:" << endl << solver.working_clauses << endl;
   cout << "Activity:" << solver.variable_activity << endl;
+  memory_usage m = solver.memory();
+  cout << "Memory: " << m << endl;
+  cout << "Peak memory: " << (m |= solver.peak_memory()) << endl;
 }
 
 void ui::usage() {
@@ -154,22 +157,26 @@ ui::answer ui::ask() {
     }
     else if (action=="forget wide") {
       history.push_back(line);
-      solver.forget_wide(w);
+      size_t forgotten = solver.forget_wide(w);
+      cout << "Forgot " << forgotten << " clauses" << endl;
       return solver.decide_plugin(solver);
     }
     else if (action=="forget domain") {
       history.push_back(line);
-      solver.forget_domain(domain);
+      size_t forgotten = solver.forget_domain(domain);
+      cout << "Forgot " << forgotten << " clauses" << endl;
       return solver.decide_plugin(solver);
     }
     else if (action=="forget touches any") {
       history.push_back(line);
-      solver.forget_touches_any(domain);
+      size_t forgotten = solver.forget_touches_any(domain);
+      cout << "Forgot " << forgotten << " clauses" << endl;
       return solver.decide_plugin(solver);
     }
     else if (action=="forget touches all") {
       history.push_back(line);
-      solver.forget_touches_all(domain);
+      size_t forgotten = solver.forget_touches_all(domain);
+      cout << "Forgot " << forgotten << " clauses" << endl;
       return solver.decide_plugin(solver);
     }
     else if (action == "assign") {
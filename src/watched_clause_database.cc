@@ -1,6 +1,7 @@
 #include "watched_clause_database.h"
 
 #include <iostream>
+#include <limits>
 
 #include "formatting.h"
 #include "colour.h"
@@ -78,6 +79,35 @@ void watched_clause::restrict_to_unit(const std::vector<int>& assignment,
   unassigned=1;
 }
 
+// Watch unassigned literals first, then the falsified literals that
+// will be unassigned first. There must not be any satisfied literal.
+void watched_clause::restrict_falsified(const std::vector<int>& assignment,
+                                        const std::vector<int>& decision_level) {
+  auto watch_level = [&assignment, &decision_level](literal l) {
+    if (not assignment[variable(l)]) return std::numeric_limits<int>::max();
+    assert((assignment[variable(l)]==1)!=l.polarity());
+    return decision_level[(~l).l];
+  };
+  for (size_t i=0; i<literals.size() and i<2; ++i) {
+    auto it = max_element(literals.begin()+i, literals.end(),
+                          [&watch_level](literal a, literal b) {
+                            return watch_level(a) < watch_level(b);
+                          });
+    swap(literals[i], *it);
+  }
+  unassigned = 0;
+  for (size_t i=0; i<literals.size() and i<2; ++i) {
+    if (not assignment[variable(literals[i])]) ++unassigned;
+  }
+  // If the clause is unit, the other literals are falsified no later
+  // than the second watch, so they need not be visible until we
+  // backtrack.
+  literals_visible_size = literals.size();
+  if (unassigned==1) literals_visible_size = std::min(literals.size(), size_t(2));
+  satisfied = 0;
+  assert(unassigned);
+}
+
 literal watched_clause::find_new_watch(size_t replaces, const std::vector<int>& assignment) {
   int iters=0;
   while(literals_visible_size>2) {
@@ -177,18 +207,76 @@ void watched_clause_database::reset() {
   }
 }
 
+void watched_clause_database::clear() {
+  clause_database::clear();
+  for (auto& w : watches) w.clear();
+  dirty = true;
+}
+
+// Every literal is watched until the watches are chosen; the stale
+// ones are on falsified literals and go away when they are unassigned.
 void watched_clause_database::insert(const proof_clause& c, const std::vector<int>& assignment) {
-  insert(c);
+  size_t i = working_clauses.size();
+  working_clauses.push_back(c);
   watched_clause& cc = working_clauses.back();
+  for (literal l : cc.literals) {
+    watches[l.l].push_back(i);
+  }
   cc.restrict_to_unit(assignment, decision_level);
   cc.assert_unit(assignment);
 }
 
+// With nothing assigned, the first two literals are the watches, as
+// after a reset.
 void watched_clause_database::insert(const proof_clause& c) {
   size_t i = working_clauses.size();
   working_clauses.push_back(c);
+  if (dirty) return;
   const watched_clause& cc = working_clauses.back();
-  for (literal l : cc.literals) {
-    watches[l.l].push_back(i);
+  for (size_t j=0; j<cc.literals.size() and j<2; ++j) {
+    watches[cc.literals[j].l].push_back(i);
+  }
+}
+
+// Remove every watch of clause i, including stale ones, which may
+// only be on its falsified literals.
+void watched_clause_database::unwatch(size_t i) {
+  for (literal l : working_clauses[i].literals) {
+    auto& w = watches[l.l];
+    w.erase(remove(w.begin(), w.end(), i), w.end());
+  }
+}
+
+void watched_clause_database::rewatch(size_t from, size_t to) {
+  for (literal l : working_clauses[from].literals) {
+    for (size_t& j : watches[l.l]) if (j==from) j=to;
+  }
+}
+
+clause_database_i::clause_iterator watched_clause_database::erase(clause_iterator it) {
+  size_t i = it - begin();
+  size_t last = working_clauses.size()-1;
+  if (not dirty) {
+    unwatch(i);
+    if (i != last) rewatch(last, i);
+  }
+  return clause_database::erase(it);
+}
+
+void watched_clause_database::replace(clause_iterator it, const proof_clause& c) {
+  size_t i = it - begin();
+  if (not dirty) unwatch(i);
+  clause_database::replace(it, c);
+  const watched_clause& cc = working_clauses[i];
+  if (not dirty) {
+    for (size_t j=0; j<cc.literals.size() and j<2; ++j) {
+      watches[cc.literals[j].l].push_back(i);
+    }
   }
 }
+
+size_t watched_clause_database::watch_memory() const {
+  size_t ret = watches.capacity()*sizeof(watches[0]);
+  for (const auto& w : watches) ret += w.capacity()*sizeof(size_t);
+  return ret;
+}
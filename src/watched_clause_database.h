@@ -33,7 +33,10 @@ struct watched_clause : clause_pointer {
   void restrict_to_unit(const std::vector<int>& assignment) { assert(false); }
   void restrict_to_unit(const std::vector<int>& assignment,
                         const std::vector<int>& decision_level);
+  void restrict_falsified(const std::vector<int>& assignment,
+                          const std::vector<int>& decision_level);
   void reset();
+  size_t memory() const { return literals.capacity()*sizeof(literal); }
 private:
   literal find_new_watch(size_t replaces, const std::vector<int>& assignment);
 };
@@ -42,7 +45,10 @@ std::ostream& operator << (std::ostream& o, const watched_clause& c);
 class watched_clause_database : public clause_database<watched_clause> {
 private:
   std::vector<std::vector<size_t>> watches;
+  // Watches are not set up until the first reset.
   bool dirty = true;
+  void unwatch(size_t i);
+  void rewatch(size_t from, size_t to);
 public:
   watched_clause_database(std::vector<const proof_clause*>& conflicts,
                           struct propagation_queue& propagation_queue,
@@ -53,12 +59,12 @@ public:
   virtual void assign(literal l);
   virtual void unassign(literal l);
   virtual void reset();
+  virtual void clear();
 
   virtual void set_variables(size_t variables) { watches.resize(2*variables); }
   virtual void insert(const proof_clause& c);
   virtual void insert(const proof_clause& c, const std::vector<int>& assignment);
-  virtual clause_iterator erase(clause_iterator it) {
-    dirty = true;
-    return clause_database::erase(it);
-  }
+  virtual clause_iterator erase(clause_iterator it);
+  virtual void replace(clause_iterator it, const proof_clause& c);
+  virtual size_t watch_memory() const;
 };